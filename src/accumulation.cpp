@@ -0,0 +1,30 @@
+#ifdef _WIN32
+#define _USE_MATH_DEFINES
+#include <math.h> // M_PI
+#endif
+#include <cmath>
+#include "accumulation.h"
+
+using namespace ospcommon;
+
+AccumulationTracker::AccumulationTracker(float max_translation, float max_rotation_deg)
+	: max_translation(max_translation),
+	min_rotation_cos(std::cos(max_rotation_deg * static_cast<float>(M_PI) / 180.f)),
+	has_anchor(false)
+{}
+bool AccumulationTracker::update(const AffineSpace3f &pose) {
+	if (has_anchor && length(pose.p - anchor.p) <= max_translation) {
+		// The trace of the relative rotation anchor^T * pose is 1 + 2 cos(angle)
+		const float trace = dot(anchor.l.vx, pose.l.vx) + dot(anchor.l.vy, pose.l.vy)
+			+ dot(anchor.l.vz, pose.l.vz);
+		if ((trace - 1.f) * 0.5f >= min_rotation_cos) {
+			return false;
+		}
+	}
+	anchor = pose;
+	has_anchor = true;
+	return true;
+}
+void AccumulationTracker::reset() {
+	has_anchor = false;
+}
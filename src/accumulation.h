@@ -0,0 +1,24 @@
+#pragma once
+
+#include <ospcommon/AffineSpace.h>
+
+/* Tracks whether the head is still enough to keep accumulating samples into
+ * the framebuffers. The frames are rendered from the pose accumulation started
+ * at, once the head moves further than the thresholds from it the accumulation
+ * restarts from the new pose.
+ */
+class AccumulationTracker {
+	float max_translation;
+	float min_rotation_cos;
+	bool has_anchor;
+	ospcommon::AffineSpace3f anchor;
+
+public:
+	// Thresholds on the head's movement in meters and rotation in degrees
+	AccumulationTracker(float max_translation, float max_rotation_deg);
+	// Check the new head pose, returns true if the accumulation must restart
+	bool update(const ospcommon::AffineSpace3f &pose);
+	// Force the accumulation to restart on the next update, e.g. when the scene changed
+	void reset();
+};
+
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "benchmark.h"
+#include "json_util.h"
+
+struct StageStats {
+	double mean, p50, p95, p99, max;
+};
+
+// Compute the stats of some samples, the percentiles use the nearest rank
+static StageStats compute_stats(std::vector<double> samples) {
+	StageStats stats = {};
+	if (samples.empty()) {
+		return stats;
+	}
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&](double p) {
+		const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+		return samples[std::max(rank, size_t(1)) - 1];
+	};
+	for (const auto &s : samples) {
+		stats.mean += s;
+	}
+	stats.mean /= samples.size();
+	stats.p50 = percentile(50);
+	stats.p95 = percentile(95);
+	stats.p99 = percentile(99);
+	stats.max = samples.back();
+	return stats;
+}
+// Get the samples of a stage, or the total frame time for NUM_FRAME_STAGES
+static std::vector<double> stage_samples(const std::vector<FrameTimes> &frames, size_t stage) {
+	std::vector<double> samples;
+	samples.reserve(frames.size());
+	for (const auto &f : frames) {
+		samples.push_back(stage < NUM_FRAME_STAGES ? f.stage_ms[stage] : f.total_ms);
+	}
+	return samples;
+}
+static std::string stage_label(size_t stage) {
+	return stage < NUM_FRAME_STAGES ? frame_stage_name(static_cast<FrameStage>(stage)) : "frame";
+}
+
+Benchmark::Benchmark(size_t warmup, size_t num_frames)
+	: warmup(warmup), num_frames(num_frames), frame(0)
+{
+	frames.reserve(num_frames);
+}
+bool Benchmark::record(const FrameTimes &times) {
+	if (frame++ >= warmup && frames.size() < num_frames) {
+		frames.push_back(times);
+	}
+	return frames.size() == num_frames;
+}
+void Benchmark::print_summary() const {
+	std::cout << "Benchmark of " << frames.size() << " frames after " << warmup
+		<< " warmup frames (ms):\n"
+		<< std::setw(10) << "stage" << std::setw(10) << "mean" << std::setw(10) << "p50"
+		<< std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n"
+		<< std::fixed << std::setprecision(3);
+	for (size_t i = 0; i <= NUM_FRAME_STAGES; ++i) {
+		const StageStats s = compute_stats(stage_samples(frames, i));
+		std::cout << std::setw(10) << stage_label(i) << std::setw(10) << s.mean
+			<< std::setw(10) << s.p50 << std::setw(10) << s.p95 << std::setw(10) << s.p99
+			<< std::setw(10) << s.max << "\n";
+	}
+	std::cout.unsetf(std::ios::fixed);
+}
+bool Benchmark::write_json(const std::string &file, const std::string &model,
+		const std::array<uint32_t, 2> &render_dims) const
+{
+	std::ofstream fout(file.c_str());
+	if (!fout) {
+		std::cerr << "Failed to open benchmark output " << file << "\n";
+		return false;
+	}
+	size_t over_budget = 0;
+	for (const auto &f : frames) {
+		if (f.total_ms > VIVE_FRAME_BUDGET_MS) {
+			++over_budget;
+		}
+	}
+	fout << std::setprecision(6)
+		<< "{\n"
+		<< "  \"model\": \"" << json_escape(model) << "\",\n"
+		<< "  \"render_width\": " << render_dims[0] << ",\n"
+		<< "  \"render_height\": " << render_dims[1] << ",\n"
+		<< "  \"warmup_frames\": " << warmup << ",\n"
+		<< "  \"frames\": " << frames.size() << ",\n"
+		<< "  \"budget_ms\": " << VIVE_FRAME_BUDGET_MS << ",\n"
+		<< "  \"frames_over_budget\": " << over_budget << ",\n"
+		<< "  \"stages_ms\": {\n";
+	for (size_t i = 0; i <= NUM_FRAME_STAGES; ++i) {
+		const StageStats s = compute_stats(stage_samples(frames, i));
+		fout << "    \"" << stage_label(i) << "\": {\"mean\": " << s.mean << ", \"p50\": " << s.p50
+			<< ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}"
+			<< (i < NUM_FRAME_STAGES ? ",\n" : "\n");
+	}
+	fout << "  }\n}\n";
+	if (!fout) {
+		std::cerr << "Failed to write benchmark output " << file << "\n";
+		return false;
+	}
+	std::cout << "Benchmark results written to " << file << "\n";
+	return true;
+}
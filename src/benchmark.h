@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame_timing.h"
+
+// The 90Hz frame budget of the Vive
+const double VIVE_FRAME_BUDGET_MS = 1000.0 / 90.0;
+
+/* Collects the frame times of a benchmark run, skipping the warmup
+ * frames, and reports the distribution of each stage's time
+ */
+class Benchmark {
+	size_t warmup;
+	size_t num_frames;
+	size_t frame;
+	std::vector<FrameTimes> frames;
+
+public:
+	Benchmark(size_t warmup, size_t num_frames);
+	// Record a frame's times, returns true once all frames have been measured
+	bool record(const FrameTimes &times);
+	void print_summary() const;
+	/* Write the mean, percentiles and max of each stage to a JSON file,
+	 * the model and render size are included to identify the run
+	 */
+	bool write_json(const std::string &file, const std::string &model,
+			const std::array<uint32_t, 2> &render_dims) const;
+};
+
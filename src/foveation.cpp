@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cmath>
+#include "foveation.h"
+#include "gl_util.h"
+
+/* The camera maps a foveated coordinate s to c + scale * t * (1 + k * t^2) with
+ * t = s - c, to unwarp we solve the cubic for t with Cardano's formula. Since k > 0
+ * the cubic is monotonic and has a single real root
+ */
+static const char *UNWARP_FRAG_SRC = R"(
+#version 330 core
+uniform sampler2D warped;
+uniform vec2 uv_scale;
+uniform vec2 uv_max;
+uniform float scale;
+uniform vec2 center;
+uniform vec2 coef_lo;
+uniform vec2 coef_hi;
+in vec2 uv;
+out vec4 color;
+
+float cbrt(float x) {
+	return sign(x) * pow(abs(x), 1.0 / 3.0);
+}
+float unwarp(float x, float c, float lo, float hi) {
+	float d = (x - c) / scale;
+	float k = d < 0.0 ? lo : hi;
+	if (k < 1e-4) {
+		return c + d;
+	}
+	float p = 1.0 / (3.0 * k);
+	float q = d / (2.0 * k);
+	float s = sqrt(q * q + p * p * p);
+	return c + cbrt(q + s) + cbrt(q - s);
+}
+void main(void) {
+	vec2 foveated = vec2(unwarp(uv.x, center.x, coef_lo.x, coef_hi.x),
+			unwarp(uv.y, center.y, coef_lo.y, coef_hi.y));
+	color = texture(warped, min(foveated * uv_scale, uv_max));
+}
+)";
+
+FoveationWarp::FoveationWarp(const EyeParams &eye, float scale) : scale(scale) {
+	// The camera's image plane spans [left, right] x [top, bottom], see main.cpp
+	const std::array<float, 2> lower = {eye.left, eye.top};
+	const std::array<float, 2> upper = {eye.right, eye.bottom};
+	const float stretch = 1.f / scale - 1.f;
+	for (size_t i = 0; i < 2; ++i) {
+		const float c = -lower[i] / (upper[i] - lower[i]);
+		center[i] = std::min(std::max(c, 0.05f), 0.95f);
+		coef_lo[i] = stretch / (center[i] * center[i]);
+		coef_hi[i] = stretch / ((1.f - center[i]) * (1.f - center[i]));
+	}
+}
+std::array<uint32_t, 2> foveated_dims(const std::array<uint32_t, 2> &eye_dims, float scale) {
+	std::array<uint32_t, 2> dims;
+	for (size_t i = 0; i < dims.size(); ++i) {
+		dims[i] = std::max(static_cast<uint32_t>(std::round(eye_dims[i] * scale)), uint32_t(1));
+	}
+	return dims;
+}
+
+FoveationUnwarp::FoveationUnwarp() : program(0), vao(0) {}
+FoveationUnwarp::~FoveationUnwarp() {
+	if (program) {
+		glDeleteProgram(program);
+	}
+	if (vao) {
+		glDeleteVertexArrays(1, &vao);
+	}
+}
+bool FoveationUnwarp::init() {
+	program = load_program(FULLSCREEN_VERT_SRC, UNWARP_FRAG_SRC, "foveation unwarp");
+	if (!program) {
+		return false;
+	}
+	warped_unif = glGetUniformLocation(program, "warped");
+	uv_scale_unif = glGetUniformLocation(program, "uv_scale");
+	uv_max_unif = glGetUniformLocation(program, "uv_max");
+	scale_unif = glGetUniformLocation(program, "scale");
+	center_unif = glGetUniformLocation(program, "center");
+	coef_lo_unif = glGetUniformLocation(program, "coef_lo");
+	coef_hi_unif = glGetUniformLocation(program, "coef_hi");
+	glGenVertexArrays(1, &vao);
+	return true;
+}
+void FoveationUnwarp::draw(GLuint texture, const FoveationWarp &warp,
+		const std::array<uint32_t, 2> &image_dims, const std::array<uint32_t, 2> &tex_dims)
+{
+	glUseProgram(program);
+	glBindVertexArray(vao);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glUniform1i(warped_unif, 0);
+	// Only the lower left of the texture has the image, keep the filtering from
+	// reading past its last texel
+	glUniform2f(uv_scale_unif, static_cast<float>(image_dims[0]) / tex_dims[0],
+			static_cast<float>(image_dims[1]) / tex_dims[1]);
+	glUniform2f(uv_max_unif, (image_dims[0] - 0.5f) / tex_dims[0], (image_dims[1] - 0.5f) / tex_dims[1]);
+	glUniform1f(scale_unif, warp.scale);
+	glUniform2f(center_unif, warp.center[0], warp.center[1]);
+	glUniform2f(coef_lo_unif, warp.coef_lo[0], warp.coef_lo[1]);
+	glUniform2f(coef_hi_unif, warp.coef_hi[0], warp.coef_hi[1]);
+	// The textures are sRGB, so re-encode the filtered linear color when writing
+	glEnable(GL_FRAMEBUFFER_SRGB);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDisable(GL_FRAMEBUFFER_SRGB);
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "gl_core_3_3.h"
+#include "vr_backend.h"
+
+/* The warp the VR camera applies to an eye's image when rendering foveated,
+ * see src/ospray/vr_camera.cpp. Each axis is warped separately about the center
+ * of the eye's projection, where the foveated image has full resolution
+ */
+struct FoveationWarp {
+	float scale;
+	std::array<float, 2> center;
+	std::array<float, 2> coef_lo;
+	std::array<float, 2> coef_hi;
+
+	FoveationWarp(const EyeParams &eye, float scale);
+};
+
+// Size of the framebuffer to render an eye of eye_dims into when foveated at scale
+std::array<uint32_t, 2> foveated_dims(const std::array<uint32_t, 2> &eye_dims, float scale);
+
+// Resamples a foveated eye image to the full resolution image it was warped from
+class FoveationUnwarp {
+	GLuint program;
+	GLuint vao;
+	GLint warped_unif, uv_scale_unif, uv_max_unif, scale_unif, center_unif,
+		  coef_lo_unif, coef_hi_unif;
+
+public:
+	FoveationUnwarp();
+	~FoveationUnwarp();
+	FoveationUnwarp(const FoveationUnwarp&) = delete;
+	FoveationUnwarp& operator=(const FoveationUnwarp&) = delete;
+
+	bool init();
+	/* Draw the unwarped eye to the bound draw framebuffer, filling its viewport.
+	 * The foveated image is the lower left image_dims of the texture, which is tex_dims in size
+	 */
+	void draw(GLuint texture, const FoveationWarp &warp, const std::array<uint32_t, 2> &image_dims,
+			const std::array<uint32_t, 2> &tex_dims);
+};
+
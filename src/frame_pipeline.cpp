@@ -0,0 +1,79 @@
+#include "frame_pipeline.h"
+#include "profiler.h"
+
+FramePipeline::FramePipeline(size_t num_buffers) : has_pose(false), in_flight(num_buffers, false),
+	poses_finished(false), render_finished(false), closed(false)
+{}
+bool FramePipeline::push_pose(const PoseRequest &request) {
+	ProfileScope scope("push_pose");
+	std::unique_lock<std::mutex> lock(mutex);
+	pose_changed.wait(lock, [&]{ return !has_pose || closed; });
+	if (closed) {
+		return false;
+	}
+	pending_pose = request;
+	has_pose = true;
+	pose_changed.notify_all();
+	return true;
+}
+void FramePipeline::finish_poses() {
+	std::lock_guard<std::mutex> lock(mutex);
+	poses_finished = true;
+	pose_changed.notify_all();
+}
+bool FramePipeline::wait_frame(RenderedFrame &frame) {
+	ProfileScope scope("wait_frame");
+	std::unique_lock<std::mutex> lock(mutex);
+	frame_changed.wait(lock, [&]{ return !ready.empty() || render_finished || closed; });
+	if (closed || ready.empty()) {
+		return false;
+	}
+	frame = ready.front();
+	ready.pop_front();
+	return true;
+}
+void FramePipeline::release(const RenderedFrame &frame) {
+	std::lock_guard<std::mutex> lock(mutex);
+	in_flight[frame.buffer] = false;
+	frame_changed.notify_all();
+}
+bool FramePipeline::wait_pose(PoseRequest &request) {
+	ProfileScope scope("wait_pose");
+	std::unique_lock<std::mutex> lock(mutex);
+	pose_changed.wait(lock, [&]{ return has_pose || poses_finished || closed; });
+	if (closed || !has_pose) {
+		return false;
+	}
+	request = pending_pose;
+	has_pose = false;
+	pose_changed.notify_all();
+	return true;
+}
+bool FramePipeline::wait_buffer(size_t buffer) {
+	ProfileScope scope("wait_buffer");
+	std::unique_lock<std::mutex> lock(mutex);
+	frame_changed.wait(lock, [&]{ return !in_flight[buffer] || closed; });
+	return !closed;
+}
+void FramePipeline::push_frame(const RenderedFrame &frame) {
+	std::lock_guard<std::mutex> lock(mutex);
+	in_flight[frame.buffer] = true;
+	ready.push_back(frame);
+	frame_changed.notify_all();
+}
+void FramePipeline::finish_render() {
+	std::lock_guard<std::mutex> lock(mutex);
+	render_finished = true;
+	frame_changed.notify_all();
+}
+void FramePipeline::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	closed = true;
+	pose_changed.notify_all();
+	frame_changed.notify_all();
+}
+bool FramePipeline::is_closed() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return closed;
+}
+
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <ospcommon/AffineSpace.h>
+#include "frame_timing.h"
+
+// A head pose handed to the render thread to render the next frame with
+struct PoseRequest {
+	ospcommon::AffineSpace3f pose;
+	double pose_wait_ms;
+	// The vsync the frame is predicted to be shown at, if the backend has one
+	bool has_vsync;
+	std::chrono::steady_clock::time_point vsync;
+};
+
+// A frame rendered and mapped by the render thread, waiting to be presented
+struct RenderedFrame {
+	// The framebuffer the frame was rendered to
+	size_t buffer;
+	const uint32_t *pixels;
+	// The distance along each pixel's ray, null if depth isn't rendered
+	const float *depth;
+	// The head pose the frame was rendered with
+	ospcommon::AffineSpace3f pose;
+	// Size of each eye's half of the frame
+	std::array<uint32_t, 2> eye_dims;
+	FrameTimes times;
+};
+
+/* Hands poses and rendered frames between the present thread, which waits for
+ * the poses and submits the frames, and the render thread, which ray traces them.
+ * The render thread has num_buffers framebuffers so it can trace the next pose while
+ * the previous frame is still mapped and being presented. At most one pose waits
+ * for the render thread, so the pose a frame is presented with is at most one frame
+ * older than the present thread's latest.
+ */
+class FramePipeline {
+	std::mutex mutex;
+	std::condition_variable pose_changed, frame_changed;
+	bool has_pose;
+	PoseRequest pending_pose;
+	std::deque<RenderedFrame> ready;
+	std::vector<bool> in_flight;
+	bool poses_finished, render_finished, closed;
+
+public:
+	FramePipeline(size_t num_buffers);
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	// Present thread: wait for the render thread to take the last pose and give it a
+	// new one, returns false if the pipeline was closed
+	bool push_pose(const PoseRequest &request);
+	// Present thread: no more poses will be pushed, the render thread finishes the queued ones
+	void finish_poses();
+	// Present thread: wait for the next rendered frame, returns false if there are no more
+	bool wait_frame(RenderedFrame &frame);
+	// Present thread: done presenting the frame, the render thread can reuse its buffer
+	void release(const RenderedFrame &frame);
+
+	// Render thread: wait for the next pose, returns false once there are no more
+	bool wait_pose(PoseRequest &request);
+	// Render thread: wait until the buffer isn't being presented, returns false if closed
+	bool wait_buffer(size_t buffer);
+	// Render thread: queue a frame rendered to a buffer for presenting
+	void push_frame(const RenderedFrame &frame);
+	// Render thread: no more frames will be pushed
+	void finish_render();
+
+	// Either thread: stop the pipeline, waking the other thread to exit
+	void close();
+	bool is_closed();
+};
+
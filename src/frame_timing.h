@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include "profiler.h"
+
+// The stages of a frame that we time
+enum FrameStage {
+	STAGE_POSE_WAIT,
+	STAGE_RENDER,
+	STAGE_MAP,
+	STAGE_UPLOAD,
+	STAGE_BLIT,
+	STAGE_SUBMIT,
+	NUM_FRAME_STAGES
+};
+
+inline const char* frame_stage_name(FrameStage stage) {
+	static const char *names[NUM_FRAME_STAGES] = {
+		"pose_wait", "render", "map", "upload", "blit", "submit"
+	};
+	return names[stage];
+}
+
+// CPU time spent in each stage of a frame and the whole frame, in milliseconds
+struct FrameTimes {
+	std::array<double, NUM_FRAME_STAGES> stage_ms;
+	double total_ms;
+
+	FrameTimes() : total_ms(0) {
+		stage_ms.fill(0);
+	}
+};
+
+// Measures the time since it was created or the last lap
+class StageTimer {
+	std::chrono::steady_clock::time_point start;
+
+public:
+	StageTimer() : start(std::chrono::steady_clock::now()) {}
+	// Get the elapsed time in milliseconds and restart the timer
+	double lap() {
+		const auto now = std::chrono::steady_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>(now - start).count();
+		start = now;
+		return ms;
+	}
+	// Lap the timer and record the lap to the profiler as an event, the name must be a string literal
+	double lap(const char *name) {
+		const auto lap_start = start;
+		const double ms = lap();
+		if (profiler_enabled()) {
+			profiler_record(name, steady_ns(lap_start), steady_ns(start));
+		}
+		return ms;
+	}
+};
+
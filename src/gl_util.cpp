@@ -0,0 +1,64 @@
+#include <iostream>
+#include <vector>
+#include "gl_util.h"
+
+const char *FULLSCREEN_VERT_SRC = R"(
+#version 330 core
+out vec2 uv;
+void main(void) {
+	vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	uv = p;
+	gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static GLuint compile_shader(GLenum type, const char *src, const std::string &name) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &src, nullptr);
+	glCompileShader(shader);
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE) {
+		GLint len = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
+		std::vector<char> log(len + 1, '\0');
+		glGetShaderInfoLog(shader, len, nullptr, log.data());
+		std::cerr << "Failed to compile " << name << " shader:\n" << log.data() << "\n";
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+GLuint load_program(const char *vert_src, const char *frag_src, const std::string &name) {
+	const GLuint vert = compile_shader(GL_VERTEX_SHADER, vert_src, name);
+	const GLuint frag = compile_shader(GL_FRAGMENT_SHADER, frag_src, name);
+	if (!vert || !frag) {
+		if (vert) {
+			glDeleteShader(vert);
+		}
+		if (frag) {
+			glDeleteShader(frag);
+		}
+		return 0;
+	}
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vert);
+	glAttachShader(program, frag);
+	glLinkProgram(program);
+	glDetachShader(program, vert);
+	glDetachShader(program, frag);
+	glDeleteShader(vert);
+	glDeleteShader(frag);
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		GLint len = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
+		std::vector<char> log(len + 1, '\0');
+		glGetProgramInfoLog(program, len, nullptr, log.data());
+		std::cerr << "Failed to link " << name << " program:\n" << log.data() << "\n";
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
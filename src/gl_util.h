@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include "gl_core_3_3.h"
+
+/* Vertex shader for drawing a triangle covering the viewport with glDrawArrays(GL_TRIANGLES, 0, 3),
+ * passes uv in [0, 1] over the viewport to the fragment shader
+ */
+extern const char *FULLSCREEN_VERT_SRC;
+
+/* Compile and link a program from the vertex and fragment shader source,
+ * returns 0 and prints the log on failure. The name is used in the error messages
+ */
+GLuint load_program(const char *vert_src, const char *frag_src, const std::string &name);
+
@@ -0,0 +1,78 @@
+#include "gpu_profiler.h"
+#include "profiler.h"
+
+GpuProfiler::GpuProfiler() : gpu_to_steady_ns(0), initialized(false) {}
+GpuProfiler::~GpuProfiler() {
+	for (const auto &s : pending) {
+		free_queries.push_back(s.queries[0]);
+		free_queries.push_back(s.queries[1]);
+	}
+	if (!free_queries.empty()) {
+		glDeleteQueries(free_queries.size(), free_queries.data());
+	}
+}
+void GpuProfiler::init() {
+	if (!profiler_enabled()) {
+		return;
+	}
+	// Wait for the GPU to go idle so the timestamp is taken when we ask for it
+	glFinish();
+	GLint64 gpu_now = 0;
+	const int64_t before = steady_now_ns();
+	glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+	const int64_t after = steady_now_ns();
+	gpu_to_steady_ns = (before + after) / 2 - gpu_now;
+	initialized = true;
+}
+GLuint GpuProfiler::take_query() {
+	if (free_queries.empty()) {
+		free_queries.resize(32);
+		glGenQueries(free_queries.size(), free_queries.data());
+	}
+	const GLuint query = free_queries.back();
+	free_queries.pop_back();
+	return query;
+}
+size_t GpuProfiler::begin(const char *name) {
+	if (!initialized) {
+		return pending.size();
+	}
+	Scope scope;
+	scope.name = name;
+	scope.queries[0] = take_query();
+	scope.queries[1] = 0;
+	glQueryCounter(scope.queries[0], GL_TIMESTAMP);
+	pending.push_back(scope);
+	return pending.size() - 1;
+}
+void GpuProfiler::end(size_t scope) {
+	if (!initialized || scope >= pending.size()) {
+		return;
+	}
+	pending[scope].queries[1] = take_query();
+	glQueryCounter(pending[scope].queries[1], GL_TIMESTAMP);
+}
+void GpuProfiler::collect() {
+	// The GPU runs the scopes in order, so stop at the first one which isn't done
+	size_t done = 0;
+	for (; done < pending.size(); ++done) {
+		const Scope &s = pending[done];
+		if (s.queries[1] == 0) {
+			break;
+		}
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(s.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available != GL_TRUE) {
+			break;
+		}
+		GLuint64 start = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(s.queries[0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(s.queries[1], GL_QUERY_RESULT, &end);
+		profiler_record_gpu(s.name, static_cast<int64_t>(start) + gpu_to_steady_ns,
+				static_cast<int64_t>(end) + gpu_to_steady_ns);
+		free_queries.push_back(s.queries[0]);
+		free_queries.push_back(s.queries[1]);
+	}
+	pending.erase(pending.begin(), pending.begin() + done);
+}
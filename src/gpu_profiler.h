@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "gl_core_3_3.h"
+
+/* Times scopes of GL commands on the GPU with timestamp queries for the profiler.
+ * The queries are read back once available a few frames later, so the GPU is never
+ * stalled, and the GPU timestamps are mapped to the steady clock to show on the same
+ * timeline as the CPU events. Must be used on the GL context's thread
+ */
+class GpuProfiler {
+	struct Scope {
+		const char *name;
+		GLuint queries[2];
+	};
+	std::vector<GLuint> free_queries;
+	std::vector<Scope> pending;
+	// The steady clock time minus the GPU time, measured at init
+	int64_t gpu_to_steady_ns;
+	bool initialized;
+
+	GLuint take_query();
+
+public:
+	GpuProfiler();
+	~GpuProfiler();
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// Sync the GPU clock with ours, does nothing if the profiler isn't enabled
+	void init();
+	/* Start timing the GL commands issued until the scope is ended, the name must be
+	 * a string literal. Returns the scope's index to end it with
+	 */
+	size_t begin(const char *name);
+	void end(size_t scope);
+	// Record the scopes the GPU has finished, call once a frame outside any scope
+	void collect();
+};
+
@@ -0,0 +1,20 @@
+#include <cstdio>
+#include "json_util.h"
+
+std::string json_escape(const std::string &s) {
+	std::string escaped;
+	escaped.reserve(s.size());
+	for (const char c : s) {
+		if (c == '"' || c == '\\') {
+			escaped.push_back('\\');
+			escaped.push_back(c);
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char code[7];
+			std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+			escaped += code;
+		} else {
+			escaped.push_back(c);
+		}
+	}
+	return escaped;
+}
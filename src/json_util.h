@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+/* Escape a string to be written between quotes in a JSON file, the quotes and
+ * backslashes are escaped and control characters written as \uXXXX
+ */
+std::string json_escape(const std::string &s);
+
@@ -1,313 +1,658 @@
 #include <iostream>
+#include <algorithm>
 #include <array>
-#include <iomanip>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <thread>
 #include <vector>
-#define SDL_MAIN_HANDLED
-#include <SDL.h>
 #include <ospray/ospray.h>
 #include <ospcommon/vec.h>
 #include <ospcommon/AffineSpace.h>
-#include <openvr.h>
-#include "gl_core_3_3.h"
+#include "accumulation.h"
+#include "benchmark.h"
+#include "foveation.h"
+#include "resolution_controller.h"
+#include "frame_pipeline.h"
+#include "openvr_backend.h"
+#include "replay_backend.h"
+#include "mesh_cache.h"
+#include "osp_state.h"
+#include "profiler.h"
+#include "scene_loader.h"
+#include "stereo_reprojection.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
-static int WIN_WIDTH = 1280/2;
-static int WIN_HEIGHT = 720/2;
-
-// We only have final resolve textures for the eyes
-// since we don't need MSAA render targets on the GPU like
-// in the samples
-struct EyeResolveFB {
-	GLuint resolve_fb;
-	GLuint resolve_texture;
-};
-
-ospcommon::AffineSpace3f convert_vr_mat(const vr::HmdMatrix34_t &m) {
-	using namespace ospcommon;
-	return AffineSpace3f(
-			vec3f(m.m[0][0], m.m[1][0], m.m[2][0]),
-			vec3f(m.m[0][1], m.m[1][1], m.m[2][1]),
-			vec3f(m.m[0][2], m.m[1][2], m.m[2][2]),
-			vec3f(m.m[0][3], m.m[1][3], m.m[2][3]));
-}
-
-int main(int argc, const char **argv) {
-	if (argc < 2) {
-		std::cerr << "You must specify a model to render\n";
-		return 1;
+// Limit how much geometry we add to the scene each frame while the
+// model is loading, so the headset keeps getting new frames
+static const size_t MAX_LOADED_TRIANGLES_PER_FRAME = 4000000;
+// The render thread traces the next frame into one framebuffer while the
+// previous one is mapped and being presented from the other
+static const size_t NUM_FRAMEBUFFERS = 2;
+// Points along each axis of the per eye lens distortion lookup grid
+static const uint32_t DISTORTION_GRID_SIZE = 128;
+
+/* Add the meshes the loader has finished since the last frame to the model,
+ * returns true if the model changed and needs to be recommitted. The geometries
+ * of the preview meshes shown while parsing are kept in previews, and removed
+ * once loading finishes and the merged shapes have all been added. The loader
+ * can free the previews after the model is recommitted without them
+ */
+bool add_loaded_meshes(SceneLoader &loader, OSPModel world, std::vector<OSPGeometry> &previews) {
+	std::vector<LoadedMesh> meshes;
+	bool changed = loader.take_meshes(meshes, MAX_LOADED_TRIANGLES_PER_FRAME);
+	// The vertex and index arrays are owned by the loader and shared with OSPRay,
+	// the meshes from the mesh cache all share its positions
+	const float *shared_positions = nullptr;
+	OSPData pos_data = nullptr;
+	for (const auto &mesh : meshes) {
+		std::cout << "Loading mesh " << mesh.name
+			<< ", has " << mesh.num_triangles * 3 << " vertices\n";
+		if (mesh.positions != shared_positions) {
+			if (pos_data) {
+				ospRelease(pos_data);
+			}
+			pos_data = ospNewData(mesh.num_vertices, OSP_FLOAT3, mesh.positions,
+					OSP_DATA_SHARED_BUFFER);
+			ospCommit(pos_data);
+			shared_positions = mesh.positions;
+		}
+		OSPData idx_data = ospNewData(mesh.num_triangles, OSP_INT3, mesh.indices,
+				OSP_DATA_SHARED_BUFFER);
+		ospCommit(idx_data);
+		OSPGeometry geom = ospNewGeometry("triangles");
+		ospSetObject(geom, "vertex", pos_data);
+		ospSetObject(geom, "index", idx_data);
+		ospCommit(geom);
+		ospAddGeometry(world, geom);
+		ospRelease(idx_data);
+		if (mesh.preview) {
+			previews.push_back(geom);
+		} else {
+			ospRelease(geom);
+		}
 	}
-	const std::string model_file = argv[1];
-	if (SDL_Init(SDL_INIT_EVERYTHING) != 0){
-		std::cerr << "Failed to initialize SDL\n";
-		return 1;
+	if (pos_data) {
+		ospRelease(pos_data);
+	}
+	if (!previews.empty() && loader.finished()) {
+		for (OSPGeometry geom : previews) {
+			ospRemoveGeometry(world, geom);
+			ospRelease(geom);
+		}
+		previews.clear();
+		changed = true;
 	}
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 0);
-	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-#ifndef NDEBUG
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
-#endif
+	return changed;
+}
 
-	SDL_Window *win = SDL_CreateWindow("OSPRay + Vive", SDL_WINDOWPOS_CENTERED,
-			SDL_WINDOWPOS_CENTERED, WIN_WIDTH, WIN_HEIGHT, SDL_WINDOW_OPENGL);
-	if (!win){
-		std::cout << "Failed to open SDL window: " << SDL_GetError() << "\n";
-		return 1;
+/* Parse a numeric argument, returns false if the whole argument isn't a
+ * valid number for the value
+ */
+static bool parse_arg(const char *arg, size_t &value) {
+	char *end = nullptr;
+	errno = 0;
+	const unsigned long long x = std::strtoull(arg, &end, 10);
+	if (end == arg || *end != '\0' || errno == ERANGE || std::strchr(arg, '-')
+			|| x > std::numeric_limits<size_t>::max())
+	{
+		return false;
 	}
-	SDL_GLContext ctx = SDL_GL_CreateContext(win);
-	if (!ctx){
-		std::cout << "Failed to get OpenGL context: " << SDL_GetError() << "\n";
-		return 1;
+	value = static_cast<size_t>(x);
+	return true;
+}
+static bool parse_arg(const char *arg, double &value) {
+	char *end = nullptr;
+	errno = 0;
+	const double x = std::strtod(arg, &end);
+	if (end == arg || *end != '\0' || errno == ERANGE || !std::isfinite(x)) {
+		return false;
 	}
-	if (ogl_LoadFunctions() == ogl_LOAD_FAILED){
-		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Failed to Load OpenGL Functions",
-				"Could not load OpenGL functions for 3.3, OpenGL 3.3 or higher is required",
-				NULL);
-		SDL_GL_DeleteContext(ctx);
-		SDL_DestroyWindow(win);
-		SDL_Quit();
-		return 1;
+	value = x;
+	return true;
+}
+static bool parse_arg(const char *arg, float &value) {
+	double x = 0;
+	if (!parse_arg(arg, x) || std::abs(x) > std::numeric_limits<float>::max()) {
+		return false;
 	}
-	SDL_GL_SetSwapInterval(0);
-
-	ospInit(&argc, argv);
-	// Load our custom Vive code for OSPRay
-	if (ospLoadModule("vive") != OSP_NO_ERROR) {
-    std::cout << "Error loading vive module for OSPRay\n";
-    return 1;
-  }
+	value = static_cast<float>(x);
+	return true;
+}
 
-	// Setup OpenVR system
-	vr::EVRInitError vr_error;
-	vr::IVRSystem *vr_system = vr::VR_Init(&vr_error, vr::VRApplication_Scene);
-	if (vr_error != vr::VRInitError_None) {
-		std::cout << "OpenVR Init error " << vr_error << "\n";
-		return 1;
+// SDL2main wraps main on the platforms which need it, so it must take a char **argv
+int main(int argc, char **argv) {
+	ospInit(&argc, const_cast<const char**>(argv));
+	std::string model_file, replay_file, dump_dir, record_file;
+	std::string benchmark_file = "benchmark.json";
+	std::string trace_file;
+	bool replay_on_hmd = false;
+	size_t benchmark_frames = 0;
+	size_t warmup_frames = 60;
+	bool accumulate = false;
+	float accum_translation = 0.002f;
+	float accum_rotation = 0.2f;
+	bool adaptive_res = false;
+	double render_budget_ms = VIVE_FRAME_BUDGET_MS * 0.9;
+	float foveation = 1.f;
+	bool lens_distortion = false;
+	bool predict_poses = true;
+	bool submit_depth = false;
+	bool stereo_reuse = false;
+	float frame_deadline_ms = 0.f;
+	bool split_eyes = false;
+	bool valid_args = true;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		// Parse the numeric value following the argument, or flag the arguments as invalid
+		auto parse_value = [&](auto &value) {
+			const char *str = argv[++i];
+			if (!parse_arg(str, value)) {
+				std::cerr << "Invalid value '" << str << "' for " << arg << "\n";
+				valid_args = false;
+			}
+		};
+		if (arg == "--replay" && i + 1 < argc) {
+			replay_file = argv[++i];
+		} else if (arg == "--hmd") {
+			replay_on_hmd = true;
+		} else if (arg == "--dump" && i + 1 < argc) {
+			dump_dir = argv[++i];
+		} else if (arg == "--record" && i + 1 < argc) {
+			record_file = argv[++i];
+		} else if (arg == "--benchmark" && i + 1 < argc) {
+			parse_value(benchmark_frames);
+		} else if (arg == "--warmup" && i + 1 < argc) {
+			parse_value(warmup_frames);
+		} else if (arg == "--benchmark-out" && i + 1 < argc) {
+			benchmark_file = argv[++i];
+		} else if (arg == "--trace" && i + 1 < argc) {
+			trace_file = argv[++i];
+		} else if (arg == "--accumulate") {
+			accumulate = true;
+		} else if (arg == "--accum-translation" && i + 1 < argc) {
+			parse_value(accum_translation);
+		} else if (arg == "--accum-rotation" && i + 1 < argc) {
+			parse_value(accum_rotation);
+		} else if (arg == "--adaptive-res") {
+			adaptive_res = true;
+		} else if (arg == "--render-budget" && i + 1 < argc) {
+			parse_value(render_budget_ms);
+		} else if (arg == "--no-pose-prediction") {
+			predict_poses = false;
+		} else if (arg == "--depth") {
+			submit_depth = true;
+		} else if (arg == "--stereo-reuse") {
+			stereo_reuse = true;
+		} else if (arg == "--deadline" && i + 1 < argc) {
+			parse_value(frame_deadline_ms);
+			frame_deadline_ms = std::max(frame_deadline_ms, 0.f);
+		} else if (arg == "--split-eyes") {
+			split_eyes = true;
+		} else if (arg == "--lens-distortion") {
+			lens_distortion = true;
+		} else if (arg == "--foveation" && i + 1 < argc) {
+			parse_value(foveation);
+			foveation = std::min(std::max(foveation, 0.1f), 1.f);
+		} else if (!arg.empty() && arg[0] == '-') {
+			std::cerr << "Unknown option or missing value for " << arg << "\n";
+			valid_args = false;
+		} else if (!model_file.empty()) {
+			std::cerr << "Unexpected argument '" << arg << "', only one model can be given\n";
+			valid_args = false;
+		} else {
+			model_file = arg;
+		}
 	}
-	if (!vr_system->IsTrackedDeviceConnected(vr::k_unTrackedDeviceIndex_Hmd)) {
-		std::cout << "OpenVR HMD not tracking! Check connection and restart\n";
+	if (model_file.empty() || !valid_args) {
+		std::cerr << "Usage: " << argv[0] << " <model> [options]\n"
+			<< "Options:\n"
+			<< "  --record <poses>  Record the HMD poses to a file\n"
+			<< "  --replay <poses>  Run headless, replaying the recorded poses instead of using the HMD\n"
+			<< "  --hmd             Present the replayed poses on the HMD instead of running headless\n"
+			<< "  --dump <dir>      Write the headless replay frames to <dir> as PPM images\n"
+			<< "  --benchmark <n>   Time n frames after the warmup, write the stats and exit\n"
+			<< "  --warmup <n>      Number of frames to skip before benchmarking (default 60)\n"
+			<< "  --benchmark-out <file>  Benchmark JSON output file (default benchmark.json)\n"
+			<< "  --trace <file>    Profile each frame on the CPU and GPU and write a Chrome trace\n"
+			<< "  --accumulate      Accumulate samples over frames while the head is still\n"
+			<< "  --accum-translation <m>  Head movement that restarts accumulation (default 0.002)\n"
+			<< "  --accum-rotation <deg>   Head rotation that restarts accumulation (default 0.2)\n"
+			<< "  --adaptive-res    Scale the render resolution to keep the render time in budget\n"
+			<< "  --render-budget <ms>     Render time to scale the resolution for (default 10)\n"
+			<< "  --deadline <ms>   Stop starting tiles this long before each frame's vsync on the HMD,\n"
+			<< "                    the tiles at the edges of the view left out are copied from the\n"
+			<< "                    last frame\n"
+			<< "  --foveation <scale>      Render foveated at scale times the resolution along each\n"
+			<< "                           axis, concentrating the rays at the center (e.g. 0.6)\n"
+			<< "  --lens-distortion Trace the image as seen through the HMD's lenses instead of\n"
+			<< "                    having the compositor distort it\n"
+			<< "  --no-pose-prediction     Use the compositor's pose prediction instead of predicting\n"
+			<< "                           the pose from our measured latency\n"
+			<< "  --depth           Submit the traced depth with the frames for the compositor to\n"
+			<< "                    reproject them with\n"
+			<< "  --stereo-reuse    Reproject the left eye's samples to the right eye and only trace\n"
+			<< "                    the right eye's pixels they don't cover\n"
+			<< "  --split-eyes      Render the eyes at the same time, each on half the render threads\n"
+			<< "                    or its own NUMA node's\n";
 		return 1;
 	}
-	if (!vr::VRCompositor()) {
-		std::cout << "OpenVR Failed to initialize compositor\n";
-		return 1;
+	// The profiler must be enabled before the backend is setup so it can sync with the GPU
+	if (!trace_file.empty()) {
+		profiler_enable();
+		profiler_set_thread_name("present");
 	}
-	std::array<uint32_t, 2> vr_render_dims;
-	vr_system->GetRecommendedRenderTargetSize(&vr_render_dims[0], &vr_render_dims[1]);
-	std::cout << "OpenVR recommended render target resolution = " << vr_render_dims[0]
-		<< "x" << vr_render_dims[1] << "\n";
-	// use Vive's screen resolution
-	vr_render_dims[0] = 1080;
-	vr_render_dims[1] = 1200;
-	std::cout << "App render target resolution = " << vr_render_dims[0]
-		<< "x" << vr_render_dims[1] << "\n";
 
-	GLuint fbo, texture;
-	glGenFramebuffers(1, &fbo);
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, vr_render_dims[0] * 2, vr_render_dims[1], 0, GL_RGBA,
-			GL_UNSIGNED_BYTE, nullptr);
+	// Start loading the model in the background while we setup the window and headset,
+	// the scene is filled in as meshes finish loading
+	SceneLoader scene_loader(model_file);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// When benchmarking a recording is looped to get the number of frames we want
+	std::unique_ptr<Benchmark> benchmark;
+	if (benchmark_frames > 0) {
+		benchmark = std::make_unique<Benchmark>(warmup_frames, benchmark_frames);
+		if (replay_file.empty()) {
+			std::cout << "Benchmarking without a recorded path, the live HMD pose will be used\n";
+		}
+	}
+	const bool headless = !replay_file.empty() && !replay_on_hmd;
 
-	// Setup resolve targets for the eyes
-	std::array<EyeResolveFB, 2> eye_targets;
-	for (size_t i = 0; i < eye_targets.size(); ++i) {
-		glGenFramebuffers(1, &eye_targets[i].resolve_fb);
-		glGenTextures(1, &eye_targets[i].resolve_texture);
-		glBindTexture(GL_TEXTURE_2D, eye_targets[i].resolve_texture);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, vr_render_dims[0], vr_render_dims[1], 0, GL_RGBA,
-				GL_UNSIGNED_BYTE, nullptr);
+	std::unique_ptr<VrBackend> backend;
+	if (headless) {
+		std::unique_ptr<ReplayBackend> replay = std::make_unique<ReplayBackend>();
+		if (!replay->open(replay_file, dump_dir, benchmark != nullptr)) {
+			return 1;
+		}
+		backend = std::move(replay);
+	} else {
+		std::unique_ptr<OpenVrBackend> openvr = std::make_unique<OpenVrBackend>();
+		if (!openvr->init(record_file, replay_file, foveation, predict_poses, submit_depth)) {
+			return 1;
+		}
+		backend = std::move(openvr);
+	}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, eye_targets[i].resolve_fb);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-				eye_targets[i].resolve_texture, 0);
+	// Load our custom Vive code for OSPRay
+	if (ospLoadModule("vive") != OSP_NO_ERROR) {
+		std::cout << "Error loading vive module for OSPRay\n";
+		return 1;
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	using namespace ospcommon;
-	// We render both left/right eye to the same framebuffer so we need it to be
-	// 2x the width
-	const vec2i image_size(vr_render_dims[0], vr_render_dims[1]);
-
-	// TODO BUG: OSPRay's side-by-side camera can't do proper stereo because it
-	// uses the same imageStart and imageEnd for both eyes
-	std::array<OSPCamera, 2> cameras;
+	const std::array<uint32_t, 2> vr_render_dims = backend->render_dims();
+
+	// The vr camera renders both eyes in one frame, the left eye to the left
+	// half of the image and the right eye to the right half
+	// Its params are set through the state wrapper so it's only recommitted when they change
+	OSPCamera camera = ospNewCamera("vr");
+	OspObjectState camera_state(camera);
+	camera_state.set1i("stereo", 1);
+	camera_state.set1f("foveation", foveation);
 	// OSPRay does the interpupillary offset, but we do it ourselves directly
 	std::array<vec3f, 2> eye_offsets;
-	const std::array<vec3f, 2> eye_dirs = { vec3f(0.0f, 0.0f, -1.0f), vec3f(0.0f, 0.0f, -1.0f) };
-	for (size_t i = 0; i < cameras.size(); ++i) {
-		std::cout << "Eye = " << (i == 0 ? " left" : " right") << "\n";
-		auto eye_mat = vr_system->GetEyeToHeadTransform(i == 0 ? vr::Eye_Left : vr::Eye_Right);
-		eye_offsets[i] = vec3f(eye_mat.m[0][3], eye_mat.m[1][3], eye_mat.m[2][3]);
-
-		float left, right, top, bottom;
-		vr_system->GetProjectionRaw(i == 0 ? vr::Eye_Left : vr::Eye_Right, &left, &right, &top, &bottom);
-
-		cameras[i] = ospNewCamera("vr");
-
+	std::array<EyeParams, 2> eye_params;
+	const vec3f eye_dir = vec3f(0.0f, 0.0f, -1.0f);
+	const std::array<std::string, 2> eye_prefix = { "left", "right" };
+	for (size_t i = 0; i < eye_offsets.size(); ++i) {
+		const EyeParams eye = backend->eye_params(i);
+		eye_params[i] = eye;
+		eye_offsets[i] = eye.offset;
 		// move image plane (it is shifted to a side)
 		// OpenVR has +y axis pointing down so we flip bottom and top
-		ospSet2f(cameras[i], "lowerLeft", left, top);
-		ospSet2f(cameras[i], "upperRight", right, bottom);
+		camera_state.set2f(eye_prefix[i] + "LowerLeft", eye.left, eye.top);
+		camera_state.set2f(eye_prefix[i] + "UpperRight", eye.right, eye.bottom);
 	}
-
-	// Load the model w/ tinyobjloader
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string err;
-	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, model_file.c_str(),
-			nullptr, true);
-	if (!err.empty()) {
-		std::cerr << "Error loading model: " << err << "\n";
+	// Skip tracing the pixels which are never visible through the lenses.
+	// Stereo reuse needs to know which of the left eye's pixels weren't traced
+	std::vector<vec2f> left_hidden_area;
+	for (size_t i = 0; i < eye_prefix.size(); ++i) {
+		std::vector<vec2f> hidden_area;
+		if (backend->hidden_area_mesh(i, hidden_area)) {
+			if (i == 0) {
+				left_hidden_area = hidden_area;
+			}
+			OSPData hidden_data = ospNewData(hidden_area.size(), OSP_FLOAT2, hidden_area.data());
+			ospCommit(hidden_data);
+			camera_state.setData(eye_prefix[i] + "HiddenArea", hidden_data);
+			ospRelease(hidden_data);
+		}
 	}
-	if (!ret) {
-		return 1;
+	// Trace the rays through the lens distortion so the compositor doesn't have to
+	// resample the image, the grid is interpolated per ray by the camera
+	bool distortion_applied = false;
+	if (lens_distortion) {
+		const std::array<uint32_t, 2> grid_dims = {DISTORTION_GRID_SIZE, DISTORTION_GRID_SIZE};
+		std::vector<vec2f> grid;
+		if (backend->apply_lens_distortion(grid_dims, grid)) {
+			OSPData grid_data = ospNewData(grid.size(), OSP_FLOAT2, grid.data());
+			ospCommit(grid_data);
+			camera_state.setData("distortionGrid", grid_data);
+			camera_state.set2i("distortionGridSize", grid_dims[0], grid_dims[1]);
+			ospRelease(grid_data);
+			distortion_applied = true;
+		} else {
+			std::cout << "Lens distortion isn't available, rendering undistorted\n";
+		}
 	}
 
 	OSPModel world = ospNewModel();
-	// Load all the objects into ospray
-	OSPData pos_data = ospNewData(attrib.vertices.size() / 3, OSP_FLOAT3,
-			attrib.vertices.data(), OSP_DATA_SHARED_BUFFER);
-	ospCommit(pos_data);
-	for (size_t s = 0; s < shapes.size(); ++s) {
-		std::cout << "Loading mesh " << shapes[s].name
-			<< ", has " << shapes[s].mesh.indices.size() << " vertices\n";
-		const tinyobj::mesh_t &mesh = shapes[s].mesh;
-		std::vector<int32_t> indices;
-		indices.reserve(mesh.indices.size());
-		for (const auto &idx : mesh.indices) {
-			indices.push_back(idx.vertex_index);
+	std::vector<OSPGeometry> preview_geoms;
+	add_loaded_meshes(scene_loader, world, preview_geoms);
+	std::atomic<bool> scene_loaded(false);
+	// When replaying or benchmarking we want every frame to show the full scene
+	// so they're reproducible
+	if (!replay_file.empty() || benchmark) {
+		while (!scene_loader.finished() && !scene_loader.load_failed()) {
+			add_loaded_meshes(scene_loader, world, preview_geoms);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
-		OSPData idx_data = ospNewData(indices.size() / 3, OSP_INT3, indices.data());
-		ospCommit(idx_data);
-		OSPGeometry geom = ospNewGeometry("triangles");
-		ospSetObject(geom, "vertex", pos_data);
-		ospSetObject(geom, "index", idx_data);
-		ospCommit(geom);
-		ospAddGeometry(world, geom);
+		add_loaded_meshes(scene_loader, world, preview_geoms);
 	}
 	ospCommit(world);
+	if (preview_geoms.empty()) {
+		scene_loader.release_previews();
+	}
 
 	OSPRenderer renderer = ospNewRenderer("raycast_Ns");
 	ospSetObject(renderer, "model", world);
-	ospSetObject(renderer, "camera", cameras[0]);
-	ospSetVec3f(renderer, "bgColor", (osp::vec3f&)vec3f(0.05));
+	ospSetObject(renderer, "camera", camera);
+	const vec3f bg_color(0.05f);
+	ospSetVec3f(renderer, "bgColor", (const osp::vec3f&)bg_color);
+	// The "frameDeadline" and "splitEyes" are read by the vive module's load balancer, which
+	// renders the tiles center-out. The deadline is set for each frame from the time left until its vsync
+	ospSet1i(renderer, "splitEyes", split_eyes ? 1 : 0);
 	ospCommit(renderer);
-
-	std::array<OSPFrameBuffer, 2> framebuffers;
+	OspObjectState renderer_state(renderer);
+
+	// When accumulating each framebuffer keeps accumulating while the head is still,
+	// a buffer is cleared before its next frame once the head moves or the scene changes
+	// The depth channel is only rendered if the backend can submit it, e.g. not when foveated
+	uint32_t fb_channels = accumulate ? OSP_FB_COLOR | OSP_FB_ACCUM : OSP_FB_COLOR;
+	const bool render_depth = backend->wants_depth();
+	if (render_depth) {
+		fb_channels |= OSP_FB_DEPTH;
+	}
+	/* The right eye reuses the left eye's samples where it can, it's rendered into
+	 * our own images for each framebuffer since it's composed from two renders.
+	 * The warp needs the plain projection, and accumulating the reused pixels would
+	 * need their own accumulation buffer
+	 */
+	std::unique_ptr<StereoReprojection> stereo;
+	if (stereo_reuse && (foveation < 1.f || distortion_applied || accumulate)) {
+		std::cout << "Stereo reuse isn't supported with foveation, lens distortion or accumulation,"
+			<< " tracing both eyes\n";
+	} else if (stereo_reuse) {
+		stereo = std::make_unique<StereoReprojection>(eye_params, left_hidden_area);
+		fb_channels |= OSP_FB_DEPTH;
+	}
+	std::array<std::vector<uint32_t>, NUM_FRAMEBUFFERS> stereo_pixels;
+	std::array<std::vector<float>, NUM_FRAMEBUFFERS> stereo_depth;
+	AccumulationTracker accumulation(accum_translation, accum_rotation);
+	// The resolution starts at the HMD's and is scaled down if the render time is over budget.
+	// Each framebuffer is resized when it's next rendered to after the resolution changes.
+	// When foveated the framebuffers are smaller than the resolution they're unwarped to
+	ResolutionController resolution(vr_render_dims, render_budget_ms);
+	std::array<uint32_t, 2> eye_dims = foveated_dims(vr_render_dims, foveation);
+	std::array<OSPFrameBuffer, NUM_FRAMEBUFFERS> framebuffers;
+	std::array<std::array<uint32_t, 2>, NUM_FRAMEBUFFERS> fb_eye_dims;
+	std::array<const uint32_t*, NUM_FRAMEBUFFERS> mapped_pixels;
+	std::array<const float*, NUM_FRAMEBUFFERS> mapped_depth;
+	std::array<bool, NUM_FRAMEBUFFERS> restart_accum;
 	for (size_t i = 0; i < framebuffers.size(); ++i) {
-		framebuffers[i] = ospNewFrameBuffer((osp::vec2i&)image_size, OSP_FB_SRGBA, OSP_FB_COLOR);
-		ospFrameBufferClear(framebuffers[i], OSP_FB_COLOR);
+		framebuffers[i] = nullptr;
+		mapped_pixels[i] = nullptr;
+		mapped_depth[i] = nullptr;
+		restart_accum[i] = true;
 	}
-
-	std::array<vr::TrackedDevicePose_t, vr::k_unMaxTrackedDeviceCount> tracked_device_poses;
-	bool quit = false;
-	uint32_t prev_time = SDL_GetTicks();
-	const std::string win_title = "OSPRay + Vive - OSPRay time for both eyes ";
-	while (!quit) {
-		SDL_Event e;
-		while (SDL_PollEvent(&e)){
-			if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)){
-				quit = true;
+	// The pose the camera is at, set on the first frame. While accumulating it lags the head's
+	AffineSpace3f camera_pose;
+
+	/* The render thread makes all the OSPRay calls while rendering, it adds newly
+	 * loaded meshes, traces the poses given to it and maps the frames for the
+	 * present thread. A buffer is unmapped once its frame has been presented
+	 */
+	FramePipeline pipeline(NUM_FRAMEBUFFERS);
+	std::thread render_thread([&]() {
+		profiler_set_thread_name("render");
+		/* The last frame pushed to the present thread, the tiles cut off at the deadline are
+		 * copied from it. Its pixels stay valid while the next frame is rendered as its
+		 * buffer is only unmapped or rendered to again the frame after
+		 */
+		RenderedFrame last_frame;
+		last_frame.pixels = nullptr;
+		for (size_t frame = 0;; ++frame) {
+			ProfileScope frame_scope("render_frame");
+			const size_t buffer = frame % framebuffers.size();
+			if (!pipeline.wait_buffer(buffer)) {
 				break;
 			}
-		}
-
-		// Update camera based on HMD position
-		vr::VRCompositor()->WaitGetPoses(tracked_device_poses.data(), tracked_device_poses.size(), NULL, 0);
-		const AffineSpace3f hmd_mat
-			= convert_vr_mat(tracked_device_poses[vr::k_unTrackedDeviceIndex_Hmd].mDeviceToAbsoluteTracking);
-		//std::cout << "hmd_mat = [\n" << hmd_mat << "]\n";
-
+			if (mapped_pixels[buffer]) {
+				ProfileScope scope("ospUnmapFrameBuffer");
+				ospUnmapFrameBuffer(mapped_pixels[buffer], framebuffers[buffer]);
+				mapped_pixels[buffer] = nullptr;
+			}
+			if (mapped_depth[buffer]) {
+				ProfileScope scope("ospUnmapFrameBuffer");
+				ospUnmapFrameBuffer(mapped_depth[buffer], framebuffers[buffer]);
+				mapped_depth[buffer] = nullptr;
+			}
+			if (!framebuffers[buffer] || fb_eye_dims[buffer] != eye_dims) {
+				ProfileScope scope("ospNewFrameBuffer");
+				if (framebuffers[buffer]) {
+					ospRelease(framebuffers[buffer]);
+				}
+				// We render both left/right eye to the same framebuffer so we need it to be
+				// 2x the width
+				const vec2i image_size(eye_dims[0] * 2, eye_dims[1]);
+				framebuffers[buffer] = ospNewFrameBuffer((osp::vec2i&)image_size, OSP_FB_SRGBA, fb_channels);
+				fb_eye_dims[buffer] = eye_dims;
+				restart_accum[buffer] = true;
+			}
 
-		// Render each eye and upload them
-		uint32_t elapsed = 0;
-		for (size_t i = 0; i < framebuffers.size(); ++i) {
-			const uint32_t prev_time = SDL_GetTicks();
+			// Add any newly loaded meshes to the scene between frames
+			if (!scene_loaded) {
+				ProfileScope scope("add_loaded_meshes");
+				if (add_loaded_meshes(scene_loader, world, preview_geoms)) {
+					{
+						ProfileScope commit_scope("model_commit");
+						ospCommit(world);
+					}
+					{
+						ProfileScope commit_scope("renderer_commit");
+						ospCommit(renderer);
+					}
+					accumulation.reset();
+				}
+				scene_loaded = scene_loader.finished() && preview_geoms.empty();
+				if (scene_loaded) {
+					scene_loader.release_previews();
+				}
+				if (scene_loader.load_failed()) {
+					std::cerr << "Failed to load model " << model_file << "\n";
+					pipeline.close();
+					break;
+				}
+			}
 
-			// Transform the eye based on the head position
-			const vec3f eye_pos = xfmPoint(hmd_mat, eye_offsets[i]);
-			const vec3f eye_dir = xfmVector(hmd_mat, eye_dirs[i]);
-			const vec3f cam_up = xfmVector(hmd_mat, vec3f(0, 1, 0));
-			ospSetVec3f(cameras[i], "pos", (osp::vec3f&)eye_pos);
-			ospSetVec3f(cameras[i], "dir", (osp::vec3f&)eye_dir);
-			ospSetVec3f(cameras[i], "up",  (osp::vec3f&)cam_up);
-			ospCommit(cameras[i]);
-			ospSetObject(renderer, "camera", cameras[i]);
-			ospCommit(renderer);
+			PoseRequest request;
+			if (!pipeline.wait_pose(request)) {
+				break;
+			}
+			RenderedFrame rendered;
+			rendered.buffer = buffer;
+			rendered.eye_dims = eye_dims;
+			rendered.times.stage_ms[STAGE_POSE_WAIT] = request.pose_wait_ms;
+			StageTimer timer;
+
+			// While accumulating the camera stays at the pose the accumulation started from
+			// and is only updated once the head moves past the thresholds
+			bool moved = true;
+			if (accumulate) {
+				moved = accumulation.update(request.pose);
+				if (moved) {
+					restart_accum.fill(true);
+				}
+			}
+			if (moved) {
+				ProfileScope scope("camera_commit");
+				camera_pose = request.pose;
+				// Transform the eyes based on the head position, the eyes share
+				// the head's orientation and are offset by the eye to head transform
+				for (size_t i = 0; i < eye_offsets.size(); ++i) {
+					camera_state.setVec3f(eye_prefix[i] + "Pos", xfmPoint(request.pose, eye_offsets[i]));
+				}
+				camera_state.setVec3f("dir", xfmVector(request.pose, eye_dir));
+				camera_state.setVec3f("up", xfmVector(request.pose, vec3f(0, 1, 0)));
+				camera_state.commit();
+			}
 
-			ospFrameBufferClear(framebuffers[i], OSP_FB_COLOR);
-			ospRenderFrame(framebuffers[i], renderer, OSP_FB_COLOR);
-			const uint32_t cur_time = SDL_GetTicks();
-			elapsed += cur_time - prev_time;
+			// Render both eyes in a single frame
+			if (!accumulate || restart_accum[buffer]) {
+				ProfileScope scope("ospFrameBufferClear");
+				ospFrameBufferClear(framebuffers[buffer], fb_channels);
+				restart_accum[buffer] = false;
+			}
+			/* Stop starting tiles frame_deadline_ms before the frame's vsync, leaving that long
+			 * to map and submit it. If it's already too late only the first tiles are rendered.
+			 * The tiles left out are copied from the last frame, which has to be the same size
+			 */
+			float deadline_ms = 0.f;
+			if (frame_deadline_ms > 0.f && request.has_vsync && last_frame.pixels
+					&& last_frame.eye_dims == eye_dims)
+			{
+				const float to_vsync = std::chrono::duration<float, std::milli>(
+						request.vsync - std::chrono::steady_clock::now()).count();
+				deadline_ms = std::max(to_vsync - frame_deadline_ms, std::numeric_limits<float>::min());
+			}
+			if (frame_deadline_ms > 0.f) {
+				const size_t num_pixels = eye_dims[0] * 2 * eye_dims[1];
+				OSPData color = nullptr;
+				OSPData depth = nullptr;
+				if (deadline_ms > 0.f) {
+					color = ospNewData(num_pixels, OSP_UINT, last_frame.pixels, OSP_DATA_SHARED_BUFFER);
+					ospCommit(color);
+				}
+				if (deadline_ms > 0.f && last_frame.depth) {
+					depth = ospNewData(num_pixels, OSP_FLOAT, last_frame.depth, OSP_DATA_SHARED_BUFFER);
+					ospCommit(depth);
+				}
+				renderer_state.setData("previousColor", color);
+				renderer_state.setData("previousDepth", depth);
+				if (color) {
+					ospRelease(color);
+				}
+				if (depth) {
+					ospRelease(depth);
+				}
+			}
+			if (stereo) {
+				const size_t num_pixels = eye_dims[0] * 2 * eye_dims[1];
+				stereo_pixels[buffer].resize(num_pixels);
+				stereo_depth[buffer].resize(render_depth ? num_pixels : 0);
+				stereo->render(framebuffers[buffer], renderer_state, camera_state, fb_channels,
+						deadline_ms, eye_dims,
+						stereo_pixels[buffer].data(), render_depth ? stereo_depth[buffer].data() : nullptr);
+			} else {
+				renderer_state.set1f("frameDeadline", deadline_ms);
+				renderer_state.commit();
+				ProfileScope scope("ospRenderFrame");
+				ospRenderFrame(framebuffers[buffer], renderer, fb_channels);
+			}
+			rendered.times.stage_ms[STAGE_RENDER] = timer.lap();
+			if (adaptive_res && resolution.update(rendered.times.stage_ms[STAGE_RENDER])) {
+				eye_dims = foveated_dims(resolution.dims(), foveation);
+			}
 
-			const uint32_t *fb = static_cast<const uint32_t*>(ospMapFrameBuffer(framebuffers[i], OSP_FB_COLOR));
-			glBindTexture(GL_TEXTURE_2D, texture);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, vr_render_dims[0] * i, 0, vr_render_dims[0], vr_render_dims[1],
-					GL_RGBA, GL_UNSIGNED_BYTE, fb);
-			ospUnmapFrameBuffer(fb, framebuffers[i]);
+			if (stereo) {
+				rendered.pixels = stereo_pixels[buffer].data();
+				rendered.depth = render_depth ? stereo_depth[buffer].data() : nullptr;
+			} else {
+				ProfileScope scope("ospMapFrameBuffer");
+				mapped_pixels[buffer] = static_cast<const uint32_t*>(ospMapFrameBuffer(framebuffers[buffer],
+							OSP_FB_COLOR));
+				rendered.pixels = mapped_pixels[buffer];
+				if (render_depth) {
+					mapped_depth[buffer] = static_cast<const float*>(ospMapFrameBuffer(framebuffers[buffer],
+								OSP_FB_DEPTH));
+				}
+				rendered.depth = mapped_depth[buffer];
+			}
+			rendered.pose = camera_pose;
+			rendered.times.stage_ms[STAGE_MAP] = timer.lap();
+			pipeline.push_frame(rendered);
+			last_frame = rendered;
 		}
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
-
-		// Blit the left/right eye halves of the ospray framebuffer to the left/right resolve targets
-		// and submit them
-		for (size_t i = 0; i < eye_targets.size(); ++i) {
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, eye_targets[i].resolve_fb);
-			glBlitFramebuffer(vr_render_dims[0] * i, 0, vr_render_dims[0] * i + vr_render_dims[0], vr_render_dims[1],
-					0, 0, vr_render_dims[0], vr_render_dims[1], GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		pipeline.finish_render();
+	});
+
+	/* The present thread waits for the poses and presents the frames, after handing
+	 * the render thread the next pose it presents the previous frame while the
+	 * next one is traced. The first pose is given before the loop to fill the pipeline
+	 */
+	bool benchmark_failed = false;
+	bool more_poses = true;
+	const std::string status_prefix = "OSPRay time for both eyes ";
+	StageTimer frame_timer;
+	for (bool first = true; backend->poll_events(); first = false) {
+		ProfileScope frame_scope("present_frame");
+		if (more_poses) {
+			PoseRequest request;
+			StageTimer pose_timer;
+			more_poses = backend->wait_get_pose(request.pose);
+			request.pose_wait_ms = pose_timer.lap();
+			request.has_vsync = more_poses && backend->predicted_vsync(request.vsync);
+			if (!more_poses) {
+				pipeline.finish_poses();
+			} else if (!pipeline.push_pose(request)) {
+				break;
+			}
+		}
+		if (first && more_poses) {
+			continue;
 		}
-		vr::Texture_t left_eye = {};
-		left_eye.handle = reinterpret_cast<void*>(eye_targets[0].resolve_texture);
-		left_eye.eType = vr::TextureType_OpenGL;
-		left_eye.eColorSpace = vr::ColorSpace_Gamma;
-
-		vr::Texture_t right_eye = {};
-		right_eye.handle = reinterpret_cast<void*>(eye_targets[1].resolve_texture);
-		right_eye.eType = vr::TextureType_OpenGL;
-		right_eye.eColorSpace = vr::ColorSpace_Gamma;
-
-		vr::VRCompositor()->Submit(vr::Eye_Left, &left_eye, nullptr);//, vr::Submit_LensDistortionAlreadyApplied);
-		vr::VRCompositor()->Submit(vr::Eye_Right, &right_eye, nullptr);//, vr::Submit_LensDistortionAlreadyApplied);
-		glFlush();
-
-		// Blit the app window display
-#if 1
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-		glBlitFramebuffer(0, 0, vr_render_dims[0] * 2, vr_render_dims[1], 0, 0, WIN_WIDTH, WIN_HEIGHT,
-				GL_COLOR_BUFFER_BIT, GL_NEAREST);
-#endif
-		SDL_GL_SwapWindow(win);
 
-#if 1
-		const std::string title = win_title + std::to_string(elapsed) + "ms";
-		SDL_SetWindowTitle(win, title.c_str());
-#endif
+		RenderedFrame rendered;
+		if (!pipeline.wait_frame(rendered)) {
+			break;
+		}
+		{
+			ProfileScope scope("submit");
+			backend->submit(rendered.pixels, rendered.depth, rendered.eye_dims, rendered.pose, rendered.times);
+		}
+		pipeline.release(rendered);
+		rendered.times.total_ms = frame_timer.lap();
+
+		backend->show_status(status_prefix + std::to_string(static_cast<int>(rendered.times.stage_ms[STAGE_RENDER]))
+			+ "ms" + (adaptive_res ? " at " + std::to_string(rendered.eye_dims[0]) + "x"
+				+ std::to_string(rendered.eye_dims[1]) : "")
+			+ (scene_loaded ? "" : " (loading)"));
+		if (benchmark && benchmark->record(rendered.times)) {
+			benchmark->print_summary();
+			benchmark_failed = !benchmark->write_json(benchmark_file, model_file, vr_render_dims);
+			break;
+		}
+	}
+	pipeline.close();
+	render_thread.join();
+	for (size_t i = 0; i < framebuffers.size(); ++i) {
+		if (mapped_pixels[i]) {
+			ospUnmapFrameBuffer(mapped_pixels[i], framebuffers[i]);
+		}
+		if (mapped_depth[i]) {
+			ospUnmapFrameBuffer(mapped_depth[i], framebuffers[i]);
+		}
 	}
 
-	vr::VR_Shutdown();
-	SDL_GL_DeleteContext(ctx);
-	SDL_DestroyWindow(win);
-	SDL_Quit();
-	return 0;
+	backend = nullptr;
+	bool trace_failed = false;
+	if (!trace_file.empty()) {
+		trace_failed = !profiler_write(trace_file);
+	}
+	return scene_loader.load_failed() || benchmark_failed || trace_failed ? 1 : 0;
 }
-
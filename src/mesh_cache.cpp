@@ -0,0 +1,346 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "mesh_cache.h"
+
+static const char CACHE_MAGIC[8] = "OSPMESH";
+static const uint32_t CACHE_VERSION = 2;
+
+/* The cache file layout is the header, the source model path, the shape table,
+ * the shape names and then the positions and index arrays, each
+ * starting on a 16 byte boundary
+ */
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t source_path_len;
+	uint64_t source_size;
+	int64_t source_mtime_ns;
+	uint64_t num_vertices;
+	uint64_t num_shapes;
+	uint64_t positions_offset;
+};
+
+struct CacheShapeEntry {
+	uint64_t indices_offset;
+	uint64_t num_triangles;
+	uint64_t name_offset;
+	uint64_t name_len;
+};
+
+static uint64_t align16(uint64_t x) {
+	return (x + 15) & ~uint64_t(15);
+}
+
+// Check that count elements of element_size bytes at offset fit in size bytes,
+// written so none of it can overflow with the untrusted values read from the file
+static bool fits(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t size) {
+	return offset <= size && count <= (size - offset) / element_size;
+}
+
+// Check that the offset into the page aligned mapping can be read as an array of T
+template<typename T>
+static bool aligned_for(uint64_t offset) {
+	return offset % alignof(T) == 0;
+}
+
+static bool valid_indices(const int32_t *indices, uint64_t count, uint64_t num_vertices) {
+	for (uint64_t i = 0; i < count; ++i) {
+		if (indices[i] < 0 || static_cast<uint64_t>(indices[i]) >= num_vertices) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Get the file's size and modification time, the time is in nanoseconds where the
+ * platform gives them so a model rewritten within the same second still
+ * invalidates the cache
+ */
+static bool source_stats(const std::string &file, uint64_t &size, int64_t &mtime_ns) {
+	const int64_t NS_PER_S = 1000000000;
+#ifdef _WIN32
+	struct _stat64 s;
+	if (_stat64(file.c_str(), &s) != 0) {
+		return false;
+	}
+	mtime_ns = static_cast<int64_t>(s.st_mtime) * NS_PER_S;
+#else
+	struct stat s;
+	if (stat(file.c_str(), &s) != 0) {
+		return false;
+	}
+#ifdef __APPLE__
+	mtime_ns = static_cast<int64_t>(s.st_mtimespec.tv_sec) * NS_PER_S + s.st_mtimespec.tv_nsec;
+#else
+	mtime_ns = static_cast<int64_t>(s.st_mtim.tv_sec) * NS_PER_S + s.st_mtim.tv_nsec;
+#endif
+#endif
+	size = static_cast<uint64_t>(s.st_size);
+	return true;
+}
+
+std::string mesh_cache_file(const std::string &model_file) {
+	return model_file + ".ospmesh";
+}
+
+MeshCache::MeshCache() : mapping(nullptr), mapping_size(0),
+#ifdef _WIN32
+	file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr),
+#endif
+	positions(nullptr), num_vertices(0)
+{}
+MeshCache::~MeshCache() {
+	close();
+}
+bool MeshCache::open(const std::string &model_file) {
+	close();
+	uint64_t source_size = 0;
+	int64_t source_mtime_ns = 0;
+	if (!source_stats(model_file, source_size, source_mtime_ns)) {
+		return false;
+	}
+
+	const std::string cache_file = mesh_cache_file(model_file);
+#ifdef _WIN32
+	file_handle = CreateFileA(cache_file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size)
+			|| static_cast<uint64_t>(file_size.QuadPart) < sizeof(CacheHeader))
+	{
+		close();
+		return false;
+	}
+	mapping_size = static_cast<size_t>(file_size.QuadPart);
+	mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping_handle) {
+		close();
+		return false;
+	}
+	mapping = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (!mapping) {
+		close();
+		return false;
+	}
+#else
+	const int fd = ::open(cache_file.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+	struct stat s;
+	if (fstat(fd, &s) != 0 || static_cast<size_t>(s.st_size) < sizeof(CacheHeader)) {
+		::close(fd);
+		return false;
+	}
+	mapping_size = static_cast<size_t>(s.st_size);
+	mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED) {
+		mapping = nullptr;
+		close();
+		return false;
+	}
+#endif
+
+	const char *base = static_cast<const char*>(mapping);
+	CacheHeader header;
+	std::memcpy(&header, base, sizeof(CacheHeader));
+	if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+			|| header.version != CACHE_VERSION
+			|| header.source_size != source_size || header.source_mtime_ns != source_mtime_ns
+			|| !fits(sizeof(CacheHeader), header.source_path_len, 1, mapping_size)
+			|| model_file.compare(0, std::string::npos, base + sizeof(CacheHeader),
+				header.source_path_len) != 0)
+	{
+		close();
+		return false;
+	}
+
+	const uint64_t table_offset = align16(sizeof(CacheHeader) + header.source_path_len);
+	if (!fits(table_offset, header.num_shapes, sizeof(CacheShapeEntry), mapping_size)
+			|| !fits(header.positions_offset, header.num_vertices, 3 * sizeof(float), mapping_size)
+			|| !aligned_for<float>(header.positions_offset))
+	{
+		close();
+		return false;
+	}
+	positions = reinterpret_cast<const float*>(base + header.positions_offset);
+	num_vertices = header.num_vertices;
+
+	const CacheShapeEntry *entries = reinterpret_cast<const CacheShapeEntry*>(base + table_offset);
+	shapes.reserve(header.num_shapes);
+	for (uint64_t i = 0; i < header.num_shapes; ++i) {
+		const CacheShapeEntry &e = entries[i];
+		if (!fits(e.name_offset, e.name_len, 1, mapping_size)
+				|| !fits(e.indices_offset, e.num_triangles, 3 * sizeof(int32_t), mapping_size)
+				|| !aligned_for<int32_t>(e.indices_offset))
+		{
+			close();
+			return false;
+		}
+		// The indices are shared with OSPRay as is, so a corrupt cache must not
+		// index past the positions
+		MeshCacheShape shape;
+		shape.indices = reinterpret_cast<const int32_t*>(base + e.indices_offset);
+		if (!valid_indices(shape.indices, e.num_triangles * 3, num_vertices)) {
+			close();
+			return false;
+		}
+		shape.name = std::string(base + e.name_offset, e.name_len);
+		shape.num_triangles = e.num_triangles;
+		shapes.push_back(shape);
+	}
+	return true;
+}
+void MeshCache::close() {
+#ifdef _WIN32
+	if (mapping) {
+		UnmapViewOfFile(mapping);
+	}
+	if (mapping_handle) {
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_handle);
+	}
+	mapping_handle = nullptr;
+	file_handle = INVALID_HANDLE_VALUE;
+#else
+	if (mapping) {
+		munmap(mapping, mapping_size);
+	}
+#endif
+	mapping = nullptr;
+	mapping_size = 0;
+	positions = nullptr;
+	num_vertices = 0;
+	shapes.clear();
+}
+
+static void write_padding(std::ofstream &fout, uint64_t offset) {
+	const char zeros[16] = {0};
+	const uint64_t pos = static_cast<uint64_t>(fout.tellp());
+	fout.write(zeros, offset - pos);
+}
+
+// Get the model vertex a piece's index refers to, -1 if it's out of range
+static int64_t piece_vertex(const MeshCachePiece &p, size_t i, uint64_t num_vertices) {
+	const int64_t v = p.vertex_ids ? p.vertex_ids[p.indices[i]] : p.indices[i];
+	return v >= 0 && static_cast<uint64_t>(v) < num_vertices ? v : -1;
+}
+
+bool write_mesh_cache(const std::string &model_file, const float *positions, size_t num_vertices,
+		const std::vector<MeshCacheSource> &shapes)
+{
+	CacheHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.source_path_len = static_cast<uint32_t>(model_file.size());
+	if (!source_stats(model_file, header.source_size, header.source_mtime_ns)) {
+		return false;
+	}
+	header.num_vertices = num_vertices;
+	header.num_shapes = shapes.size();
+
+	// Don't cache a model with out of range indices, the cache would be rejected
+	// when it's opened
+	for (const auto &s : shapes) {
+		for (const auto &p : s.pieces) {
+			for (size_t i = 0; i < p.num_triangles * 3; ++i) {
+				if (piece_vertex(p, i, header.num_vertices) < 0) {
+					return false;
+				}
+			}
+		}
+	}
+
+	// Lay out the shape table, names, positions and indices
+	const uint64_t table_offset = align16(sizeof(CacheHeader) + header.source_path_len);
+	uint64_t offset = table_offset + shapes.size() * sizeof(CacheShapeEntry);
+	std::vector<CacheShapeEntry> entries(shapes.size());
+	for (size_t i = 0; i < shapes.size(); ++i) {
+		entries[i].name_offset = offset;
+		entries[i].name_len = shapes[i].name.size();
+		offset += shapes[i].name.size();
+	}
+	header.positions_offset = align16(offset);
+	offset = header.positions_offset + header.num_vertices * 3 * sizeof(float);
+	for (size_t i = 0; i < shapes.size(); ++i) {
+		entries[i].indices_offset = align16(offset);
+		entries[i].num_triangles = 0;
+		for (const auto &p : shapes[i].pieces) {
+			entries[i].num_triangles += p.num_triangles;
+		}
+		offset = entries[i].indices_offset + entries[i].num_triangles * 3 * sizeof(int32_t);
+	}
+
+	// Write to a temp file and move it over the cache once it's complete, so
+	// a failed write never leaves a partial cache behind
+	const std::string cache_file = mesh_cache_file(model_file);
+	const std::string tmp_file = cache_file + ".tmp";
+	{
+		std::ofstream fout(tmp_file.c_str(), std::ios::binary);
+		if (!fout) {
+			return false;
+		}
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+		fout.write(model_file.data(), model_file.size());
+		write_padding(fout, table_offset);
+		fout.write(reinterpret_cast<const char*>(entries.data()),
+				entries.size() * sizeof(CacheShapeEntry));
+		for (const auto &s : shapes) {
+			fout.write(s.name.data(), s.name.size());
+		}
+		write_padding(fout, header.positions_offset);
+		fout.write(reinterpret_cast<const char*>(positions),
+				header.num_vertices * 3 * sizeof(float));
+
+		// The pieces' indices are mapped to the model's vertices through a small
+		// buffer, so the merged index arrays are never held in memory
+		std::vector<int32_t> buffer;
+		buffer.reserve(3 * 4096);
+		for (size_t i = 0; i < shapes.size(); ++i) {
+			write_padding(fout, entries[i].indices_offset);
+			for (const auto &p : shapes[i].pieces) {
+				for (size_t j = 0; j < p.num_triangles * 3; ++j) {
+					buffer.push_back(static_cast<int32_t>(piece_vertex(p, j, header.num_vertices)));
+					if (buffer.size() == buffer.capacity()) {
+						fout.write(reinterpret_cast<const char*>(buffer.data()),
+								buffer.size() * sizeof(int32_t));
+						buffer.clear();
+					}
+				}
+			}
+			fout.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(int32_t));
+			buffer.clear();
+		}
+		if (!fout) {
+			fout.close();
+			std::remove(tmp_file.c_str());
+			return false;
+		}
+	}
+	std::remove(cache_file.c_str());
+	if (std::rename(tmp_file.c_str(), cache_file.c_str()) != 0) {
+		std::remove(tmp_file.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* The mesh cache is a flat binary copy of a model's triangle meshes stored
+ * next to the model as <model>.ospmesh. It holds a header, the float3 vertex
+ * positions and an int3 index array per shape. The cache is keyed by the source
+ * model's path, size and modification time, so it's rebuilt when the model changes.
+ * When opened the file is memory mapped and the positions and indices point
+ * directly into the mapping, so they can be shared with OSPRay without a copy.
+ * The indices are checked against the vertex count when opening, so a corrupt
+ * cache is rebuilt instead of being rendered.
+ */
+struct MeshCacheShape {
+	std::string name;
+	const int32_t *indices;
+	size_t num_triangles;
+};
+
+class MeshCache {
+	void *mapping;
+	size_t mapping_size;
+#ifdef _WIN32
+	void *file_handle;
+	void *mapping_handle;
+#endif
+
+public:
+	const float *positions;
+	size_t num_vertices;
+	std::vector<MeshCacheShape> shapes;
+
+	MeshCache();
+	~MeshCache();
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	/* Map the cache for the model file, returns false if there's no
+	 * cache or it's out of date
+	 */
+	bool open(const std::string &model_file);
+	void close();
+};
+
+// Get the cache file name for the model
+std::string mesh_cache_file(const std::string &model_file);
+
+/* A run of a shape's triangles to write to the cache, the indices are into
+ * vertex_ids which maps them to the model's vertices, or directly into the
+ * model's vertices if vertex_ids is null
+ */
+struct MeshCachePiece {
+	const int32_t *indices;
+	size_t num_triangles;
+	const int32_t *vertex_ids;
+};
+
+struct MeshCacheSource {
+	std::string name;
+	std::vector<MeshCachePiece> pieces;
+};
+
+/* Write the cache for the model from its vertex positions and the pieces of
+ * each shape, the pieces of a shape are written in order as one index array
+ */
+bool write_mesh_cache(const std::string &model_file, const float *positions, size_t num_vertices,
+		const std::vector<MeshCacheSource> &shapes);
@@ -0,0 +1,507 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "openvr_backend.h"
+
+static int WIN_WIDTH = 1280/2;
+static int WIN_HEIGHT = 720/2;
+// Enough upload slots that we don't wait on the GPU reading the previous frames
+static const size_t NUM_UPLOAD_SLOTS = 3;
+// Weight of the latest frame in the running latency estimate
+static const double LATENCY_SMOOTHING = 0.1;
+// Clip planes of the projection the submitted depth is in, in meters
+static const float DEPTH_NEAR = 0.05f;
+static const float DEPTH_FAR = 100.f;
+
+static ospcommon::AffineSpace3f convert_vr_mat(const vr::HmdMatrix34_t &m) {
+	using namespace ospcommon;
+	return AffineSpace3f(
+			vec3f(m.m[0][0], m.m[1][0], m.m[2][0]),
+			vec3f(m.m[0][1], m.m[1][1], m.m[2][1]),
+			vec3f(m.m[0][2], m.m[1][2], m.m[2][2]),
+			vec3f(m.m[0][3], m.m[1][3], m.m[2][3]));
+}
+static vr::HmdMatrix34_t convert_to_vr_mat(const ospcommon::AffineSpace3f &a) {
+	vr::HmdMatrix34_t m;
+	for (size_t i = 0; i < 3; ++i) {
+		m.m[i][0] = a.l.vx[i];
+		m.m[i][1] = a.l.vy[i];
+		m.m[i][2] = a.l.vz[i];
+		m.m[i][3] = a.p[i];
+	}
+	return m;
+}
+
+OpenVrBackend::OpenVrBackend() : win(nullptr), ctx(nullptr), vr_system(nullptr), foveation(1.f),
+	distortion_applied(false), submit_depth(false), predict_poses(false), frame_duration(0.f), vsync_to_photons(0.f),
+	latency_estimate(0.0), next_replay_pose(0)
+{}
+OpenVrBackend::~OpenVrBackend() {
+	upload_ring.reset();
+	unwarp.reset();
+	depth_ring.reset();
+	depth_resolve.reset();
+	gpu_profiler.reset();
+	if (vr_system) {
+		vr::VR_Shutdown();
+	}
+	if (ctx) {
+		SDL_GL_DeleteContext(ctx);
+	}
+	if (win) {
+		SDL_DestroyWindow(win);
+	}
+	SDL_Quit();
+}
+bool OpenVrBackend::init(const std::string &record_file, const std::string &replay_file,
+		float foveation_scale, bool predict, bool depth)
+{
+	foveation = foveation_scale;
+	predict_poses = predict;
+	// The foveated frames don't have a projection the compositor could reproject with
+	submit_depth = depth && foveation >= 1.f;
+	if (depth && !submit_depth) {
+		std::cout << "Depth can't be submitted with foveated rendering, submitting without depth\n";
+	}
+	if (!replay_file.empty() && !read_pose_recording(replay_file, replay)) {
+		return false;
+	}
+	if (SDL_Init(SDL_INIT_EVERYTHING) != 0){
+		std::cerr << "Failed to initialize SDL\n";
+		return false;
+	}
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 0);
+	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
+	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
+	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
+	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+#ifndef NDEBUG
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
+
+	win = SDL_CreateWindow("OSPRay + Vive", SDL_WINDOWPOS_CENTERED,
+			SDL_WINDOWPOS_CENTERED, WIN_WIDTH, WIN_HEIGHT, SDL_WINDOW_OPENGL);
+	if (!win){
+		std::cout << "Failed to open SDL window: " << SDL_GetError() << "\n";
+		return false;
+	}
+	ctx = SDL_GL_CreateContext(win);
+	if (!ctx){
+		std::cout << "Failed to get OpenGL context: " << SDL_GetError() << "\n";
+		return false;
+	}
+	if (ogl_LoadFunctions() == ogl_LOAD_FAILED){
+		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Failed to Load OpenGL Functions",
+				"Could not load OpenGL functions for 3.3, OpenGL 3.3 or higher is required",
+				NULL);
+		return false;
+	}
+	SDL_GL_SetSwapInterval(0);
+	gpu_profiler.reset(new GpuProfiler());
+	gpu_profiler->init();
+
+	// Setup OpenVR system
+	vr::EVRInitError vr_error;
+	vr_system = vr::VR_Init(&vr_error, vr::VRApplication_Scene);
+	if (vr_error != vr::VRInitError_None) {
+		std::cout << "OpenVR Init error " << vr_error << "\n";
+		vr_system = nullptr;
+		return false;
+	}
+	if (!vr_system->IsTrackedDeviceConnected(vr::k_unTrackedDeviceIndex_Hmd)) {
+		std::cout << "OpenVR HMD not tracking! Check connection and restart\n";
+		return false;
+	}
+	if (!vr::VRCompositor()) {
+		std::cout << "OpenVR Failed to initialize compositor\n";
+		return false;
+	}
+	vr_system->GetRecommendedRenderTargetSize(&vr_render_dims[0], &vr_render_dims[1]);
+	std::cout << "OpenVR recommended render target resolution = " << vr_render_dims[0]
+		<< "x" << vr_render_dims[1] << "\n";
+	// use Vive's screen resolution
+	vr_render_dims[0] = 1080;
+	vr_render_dims[1] = 1200;
+	std::cout << "App render target resolution = " << vr_render_dims[0]
+		<< "x" << vr_render_dims[1] << "\n";
+
+	const float display_freq = vr_system->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd,
+			vr::Prop_DisplayFrequency_Float);
+	frame_duration = display_freq > 0.f ? 1.f / display_freq : 1.f / 90.f;
+	vsync_to_photons = vr_system->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd,
+			vr::Prop_SecondsFromVsyncToPhotons_Float);
+
+	for (size_t i = 0; i < eyes.size(); ++i) {
+		const vr::EVREye eye = i == 0 ? vr::Eye_Left : vr::Eye_Right;
+		auto eye_mat = vr_system->GetEyeToHeadTransform(eye);
+		eyes[i].offset = ospcommon::vec3f(eye_mat.m[0][3], eye_mat.m[1][3], eye_mat.m[2][3]);
+		vr_system->GetProjectionRaw(eye, &eyes[i].left, &eyes[i].right, &eyes[i].top, &eyes[i].bottom);
+		eye_projections[i] = vr_system->GetProjectionMatrix(eye, DEPTH_NEAR, DEPTH_FAR);
+	}
+
+	upload_ring.reset(new PboRing());
+	if (!upload_ring->init(vr_render_dims[0] * 2 * vr_render_dims[1] * sizeof(uint32_t), NUM_UPLOAD_SLOTS)) {
+		return false;
+	}
+
+	if (foveation < 1.f) {
+		unwarp.reset(new FoveationUnwarp());
+		if (!unwarp->init()) {
+			return false;
+		}
+	}
+	if (submit_depth) {
+		depth_ring.reset(new PboRing());
+		if (!depth_ring->init(vr_render_dims[0] * 2 * vr_render_dims[1] * sizeof(float), NUM_UPLOAD_SLOTS)) {
+			return false;
+		}
+		depth_resolve.reset(new RayDepthResolve());
+		if (!depth_resolve->init()) {
+			return false;
+		}
+	}
+
+	// Setup resolve targets for the eyes
+	for (size_t i = 0; i < eye_targets.size(); ++i) {
+		glGenFramebuffers(1, &eye_targets[i].resolve_fb);
+		glGenTextures(1, &eye_targets[i].resolve_texture);
+		glBindTexture(GL_TEXTURE_2D, eye_targets[i].resolve_texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, vr_render_dims[0], vr_render_dims[1], 0, GL_RGBA,
+				GL_UNSIGNED_BYTE, nullptr);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, eye_targets[i].resolve_fb);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+				eye_targets[i].resolve_texture, 0);
+
+		glGenFramebuffers(1, &eye_targets[i].upscale_fb);
+		glGenTextures(1, &eye_targets[i].upscale_texture);
+		glBindTexture(GL_TEXTURE_2D, eye_targets[i].upscale_texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, vr_render_dims[0], vr_render_dims[1], 0, GL_RGBA,
+				GL_UNSIGNED_BYTE, nullptr);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, eye_targets[i].upscale_fb);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+				eye_targets[i].upscale_texture, 0);
+
+		eye_targets[i].ray_depth_texture = 0;
+		eye_targets[i].depth_fb = 0;
+		eye_targets[i].depth_texture = 0;
+		if (submit_depth) {
+			glGenTextures(1, &eye_targets[i].ray_depth_texture);
+			glBindTexture(GL_TEXTURE_2D, eye_targets[i].ray_depth_texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, vr_render_dims[0], vr_render_dims[1], 0, GL_RED,
+					GL_FLOAT, nullptr);
+
+			glGenFramebuffers(1, &eye_targets[i].depth_fb);
+			glGenTextures(1, &eye_targets[i].depth_texture);
+			glBindTexture(GL_TEXTURE_2D, eye_targets[i].depth_texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, vr_render_dims[0], vr_render_dims[1], 0,
+					GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, eye_targets[i].depth_fb);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+					eye_targets[i].depth_texture, 0);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!record_file.empty() && !recorder.open(record_file, vr_render_dims, eyes)) {
+		return false;
+	}
+	return true;
+}
+std::array<uint32_t, 2> OpenVrBackend::render_dims() const {
+	return vr_render_dims;
+}
+EyeParams OpenVrBackend::eye_params(size_t eye) const {
+	return eyes[eye];
+}
+bool OpenVrBackend::apply_lens_distortion(const std::array<uint32_t, 2> &grid_dims,
+		std::vector<ospcommon::vec2f> &grid)
+{
+	if (grid_dims[0] < 2 || grid_dims[1] < 2) {
+		return false;
+	}
+	grid.resize(2 * grid_dims[0] * grid_dims[1]);
+	for (size_t i = 0; i < eyes.size(); ++i) {
+		const vr::EVREye eye = i == 0 ? vr::Eye_Left : vr::Eye_Right;
+		ospcommon::vec2f *eye_grid = &grid[i * grid_dims[0] * grid_dims[1]];
+		for (size_t y = 0; y < grid_dims[1]; ++y) {
+			for (size_t x = 0; x < grid_dims[0]; ++x) {
+				// OpenVR's display and texture coordinates have +v pointing down while
+				// our images have the first row at the bottom. We only trace the green
+				// channel's mapping, the compositor doesn't correct chromatic aberration
+				// for pre-distorted frames so the red and blue fringes remain
+				const float u = static_cast<float>(x) / (grid_dims[0] - 1);
+				const float v = 1.f - static_cast<float>(y) / (grid_dims[1] - 1);
+				vr::DistortionCoordinates_t coords;
+				if (!vr_system->ComputeDistortion(eye, u, v, &coords)) {
+					std::cout << "OpenVR failed to compute the lens distortion\n";
+					return false;
+				}
+				eye_grid[y * grid_dims[0] + x] = ospcommon::vec2f(coords.rfGreen[0], 1.f - coords.rfGreen[1]);
+			}
+		}
+	}
+	distortion_applied = true;
+	// The distorted frames don't have a projection the compositor could reproject with
+	if (submit_depth) {
+		std::cout << "Depth can't be submitted with the lens distortion applied, submitting without depth\n";
+		submit_depth = false;
+	}
+	return true;
+}
+bool OpenVrBackend::hidden_area_mesh(size_t eye, std::vector<ospcommon::vec2f> &triangles) const {
+	const vr::HiddenAreaMesh_t mesh = vr_system->GetHiddenAreaMesh(eye == 0 ? vr::Eye_Left : vr::Eye_Right);
+	if (!mesh.pVertexData || mesh.unTriangleCount == 0) {
+		return false;
+	}
+	// OpenVR's mesh has +y pointing down while our images have the first row at the bottom
+	triangles.resize(mesh.unTriangleCount * 3);
+	for (size_t i = 0; i < triangles.size(); ++i) {
+		triangles[i] = ospcommon::vec2f(mesh.pVertexData[i].v[0], 1.f - mesh.pVertexData[i].v[1]);
+	}
+	return true;
+}
+bool OpenVrBackend::poll_events() {
+	SDL_Event e;
+	while (SDL_PollEvent(&e)){
+		if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)){
+			return false;
+		}
+	}
+	return true;
+}
+bool OpenVrBackend::wait_get_pose(ospcommon::AffineSpace3f &hmd_pose) {
+	{
+		ProfileScope scope("WaitGetPoses");
+		vr::VRCompositor()->WaitGetPoses(tracked_device_poses.data(), tracked_device_poses.size(), NULL, 0);
+	}
+	pose_times.push_back(std::chrono::steady_clock::now());
+	/* The frame rendered with this pose is submitted after our latency estimate and shown
+	 * at the first vsync after that
+	 */
+	float since_vsync = 0.f;
+	uint64_t frame_counter = 0;
+	vr_system->GetTimeSinceLastVsync(&since_vsync, &frame_counter);
+	const double vsyncs = std::ceil((since_vsync + latency_estimate) / frame_duration);
+	const double to_vsync = std::max(vsyncs, 1.0) * frame_duration - since_vsync;
+	next_vsync = pose_times.back() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(to_vsync));
+	if (predict_poses) {
+		// Predict the pose for when the frame's photons are out
+		ProfileScope scope("predict_pose");
+		const float predict_time = static_cast<float>(to_vsync) + vsync_to_photons;
+		std::array<vr::TrackedDevicePose_t, vr::k_unMaxTrackedDeviceCount> predicted;
+		vr_system->GetDeviceToAbsoluteTrackingPose(vr::VRCompositor()->GetTrackingSpace(), predict_time,
+				predicted.data(), predicted.size());
+		if (predicted[vr::k_unTrackedDeviceIndex_Hmd].bPoseIsValid) {
+			tracked_device_poses = predicted;
+		}
+	}
+	hmd_pose = convert_vr_mat(tracked_device_poses[vr::k_unTrackedDeviceIndex_Hmd].mDeviceToAbsoluteTracking);
+	if (!replay.poses.empty()) {
+		hmd_pose = replay.poses[next_replay_pose];
+		next_replay_pose = (next_replay_pose + 1) % replay.poses.size();
+	}
+	if (recorder.is_open()) {
+		recorder.record(hmd_pose);
+	}
+	return true;
+}
+bool OpenVrBackend::predicted_vsync(std::chrono::steady_clock::time_point &vsync) const {
+	vsync = next_vsync;
+	return true;
+}
+bool OpenVrBackend::wants_depth() const {
+	return submit_depth;
+}
+void OpenVrBackend::submit(const uint32_t *image, const float *depth, const std::array<uint32_t, 2> &eye_dims,
+		const ospcommon::AffineSpace3f &hmd_pose, FrameTimes &times)
+{
+	StageTimer timer;
+	const size_t width = eye_dims[0] * 2;
+	const size_t height = eye_dims[1];
+	// If we rendered at a lower resolution or foveated the eyes are uploaded to the
+	// upscale textures and scaled up or unwarped to the submitted textures on the GPU
+	const bool upscale = eye_dims != vr_render_dims || unwarp;
+	// Copy the frame into the next upload slot so the texture transfers can run
+	// asynchronously from the buffer instead of the driver copying or stalling on our memory.
+	// Each eye's half of the frame is uploaded directly to the texture we submit for it
+	// when rendering at full resolution
+	const size_t gpu_upload = gpu_profiler->begin("upload");
+	void *slot = upload_ring->map_next();
+	const char *pixels = reinterpret_cast<const char*>(image);
+	if (slot) {
+		ProfileScope scope("copy_to_pbo");
+		std::memcpy(slot, image, width * height * sizeof(uint32_t));
+		pixels = reinterpret_cast<const char*>(upload_ring->bind_for_unpack());
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+	for (size_t i = 0; i < eye_targets.size(); ++i) {
+		ProfileScope scope("glTexSubImage2D");
+		glBindTexture(GL_TEXTURE_2D, upscale ? eye_targets[i].upscale_texture : eye_targets[i].resolve_texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, eye_dims[0], eye_dims[1],
+				GL_RGBA, GL_UNSIGNED_BYTE, pixels + i * eye_dims[0] * sizeof(uint32_t));
+	}
+	if (slot) {
+		upload_ring->fence();
+	}
+	// The ray distances go through their own upload slots the same way
+	const bool with_depth = submit_depth && depth;
+	if (with_depth) {
+		void *depth_slot = depth_ring->map_next();
+		const char *distances = reinterpret_cast<const char*>(depth);
+		if (depth_slot) {
+			ProfileScope scope("copy_to_pbo");
+			std::memcpy(depth_slot, depth, width * height * sizeof(float));
+			distances = reinterpret_cast<const char*>(depth_ring->bind_for_unpack());
+		}
+		for (size_t i = 0; i < eye_targets.size(); ++i) {
+			ProfileScope scope("glTexSubImage2D");
+			glBindTexture(GL_TEXTURE_2D, eye_targets[i].ray_depth_texture);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, eye_dims[0], eye_dims[1],
+					GL_RED, GL_FLOAT, distances + i * eye_dims[0] * sizeof(float));
+		}
+		if (depth_slot) {
+			depth_ring->fence();
+		}
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	gpu_profiler->end(gpu_upload);
+	times.stage_ms[STAGE_UPLOAD] = timer.lap("upload");
+
+	const size_t gpu_blit = gpu_profiler->begin("blit");
+	if (unwarp) {
+		glViewport(0, 0, vr_render_dims[0], vr_render_dims[1]);
+		for (size_t i = 0; i < eye_targets.size(); ++i) {
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, eye_targets[i].resolve_fb);
+			unwarp->draw(eye_targets[i].upscale_texture, FoveationWarp(eyes[i], foveation),
+					eye_dims, vr_render_dims);
+		}
+	} else if (upscale) {
+		for (size_t i = 0; i < eye_targets.size(); ++i) {
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, eye_targets[i].upscale_fb);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, eye_targets[i].resolve_fb);
+			glBlitFramebuffer(0, 0, eye_dims[0], eye_dims[1], 0, 0, vr_render_dims[0], vr_render_dims[1],
+					GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		}
+	}
+	if (with_depth) {
+		glViewport(0, 0, vr_render_dims[0], vr_render_dims[1]);
+		for (size_t i = 0; i < eye_targets.size(); ++i) {
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, eye_targets[i].depth_fb);
+			const std::array<float, 2> depth_proj = {
+				eye_projections[i].m[2][2], eye_projections[i].m[2][3]
+			};
+			depth_resolve->draw(eye_targets[i].ray_depth_texture, eyes[i], depth_proj,
+					eye_dims, vr_render_dims);
+		}
+	}
+	gpu_profiler->end(gpu_blit);
+	times.stage_ms[STAGE_BLIT] = timer.lap("blit");
+
+	vr::Texture_t left_eye = {};
+	left_eye.handle = reinterpret_cast<void*>(eye_targets[0].resolve_texture);
+	left_eye.eType = vr::TextureType_OpenGL;
+	left_eye.eColorSpace = vr::ColorSpace_Gamma;
+
+	vr::Texture_t right_eye = {};
+	right_eye.handle = reinterpret_cast<void*>(eye_targets[1].resolve_texture);
+	right_eye.eType = vr::TextureType_OpenGL;
+	right_eye.eColorSpace = vr::ColorSpace_Gamma;
+
+	const vr::EVRSubmitFlags submit_flags = distortion_applied ? vr::Submit_LensDistortionAlreadyApplied
+		: vr::Submit_Default;
+	if (with_depth && replay.poses.empty()) {
+		// Tell the compositor the pose we rendered with, so it reprojects from where the
+		// frame was actually seen and can use the depth to correct the parallax
+		const vr::HmdMatrix34_t pose = convert_to_vr_mat(hmd_pose);
+		for (size_t i = 0; i < eye_targets.size(); ++i) {
+			ProfileScope scope("Submit");
+			vr::VRTextureWithPoseAndDepth_t tex = {};
+			tex.handle = reinterpret_cast<void*>(eye_targets[i].resolve_texture);
+			tex.eType = vr::TextureType_OpenGL;
+			tex.eColorSpace = vr::ColorSpace_Gamma;
+			tex.mDeviceToAbsoluteTracking = pose;
+			tex.depth.handle = reinterpret_cast<void*>(eye_targets[i].depth_texture);
+			tex.depth.mProjection = eye_projections[i];
+			tex.depth.vRange.v[0] = 0.f;
+			tex.depth.vRange.v[1] = 1.f;
+			vr::VRCompositor()->Submit(i == 0 ? vr::Eye_Left : vr::Eye_Right, &tex, nullptr,
+					static_cast<vr::EVRSubmitFlags>(submit_flags | vr::Submit_TextureWithPose
+						| vr::Submit_TextureWithDepth));
+		}
+	} else if (with_depth) {
+		// The replayed poses aren't where the HMD is, so leave the compositor to
+		// assume the frame was rendered with the pose it gave us
+		for (size_t i = 0; i < eye_targets.size(); ++i) {
+			ProfileScope scope("Submit");
+			vr::VRTextureWithDepth_t tex = {};
+			tex.handle = reinterpret_cast<void*>(eye_targets[i].resolve_texture);
+			tex.eType = vr::TextureType_OpenGL;
+			tex.eColorSpace = vr::ColorSpace_Gamma;
+			tex.depth.handle = reinterpret_cast<void*>(eye_targets[i].depth_texture);
+			tex.depth.mProjection = eye_projections[i];
+			tex.depth.vRange.v[0] = 0.f;
+			tex.depth.vRange.v[1] = 1.f;
+			vr::VRCompositor()->Submit(i == 0 ? vr::Eye_Left : vr::Eye_Right, &tex, nullptr,
+					static_cast<vr::EVRSubmitFlags>(submit_flags | vr::Submit_TextureWithDepth));
+		}
+	} else {
+		ProfileScope scope("Submit");
+		vr::VRCompositor()->Submit(vr::Eye_Left, &left_eye, nullptr, submit_flags);
+		vr::VRCompositor()->Submit(vr::Eye_Right, &right_eye, nullptr, submit_flags);
+	}
+	glFlush();
+	// Frames are submitted in the order their poses were given out
+	if (!pose_times.empty()) {
+		const double latency = std::chrono::duration<double>(std::chrono::steady_clock::now()
+				- pose_times.front()).count();
+		pose_times.pop_front();
+		latency_estimate = latency_estimate == 0.0 ? latency
+			: latency_estimate + LATENCY_SMOOTHING * (latency - latency_estimate);
+	}
+	times.stage_ms[STAGE_SUBMIT] = timer.lap("submit");
+
+	// Blit the app window display from the submitted eye textures,
+	// each eye is shown in its half of the window
+#if 1
+	const size_t gpu_mirror = gpu_profiler->begin("mirror_blit");
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	for (size_t i = 0; i < eye_targets.size(); ++i) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, eye_targets[i].resolve_fb);
+		glBlitFramebuffer(0, 0, vr_render_dims[0], vr_render_dims[1],
+				i * WIN_WIDTH / 2, 0, (i + 1) * WIN_WIDTH / 2, WIN_HEIGHT,
+				GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+	gpu_profiler->end(gpu_mirror);
+#endif
+	times.stage_ms[STAGE_BLIT] += timer.lap("mirror_blit");
+	SDL_GL_SwapWindow(win);
+	times.stage_ms[STAGE_SUBMIT] += timer.lap("swap");
+	gpu_profiler->collect();
+}
+void OpenVrBackend::show_status(const std::string &status) {
+	const std::string title = "OSPRay + Vive - " + status + ", pose latency "
+		+ std::to_string(static_cast<int>(latency_estimate * 1000.0)) + "ms";
+	SDL_SetWindowTitle(win, title.c_str());
+}
+
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <SDL.h>
+#include <openvr.h>
+#include "gl_core_3_3.h"
+#include "foveation.h"
+#include "gpu_profiler.h"
+#include "pbo_ring.h"
+#include "pose_recording.h"
+#include "ray_depth.h"
+#include "vr_backend.h"
+
+// We only have final resolve textures for the eyes
+// since we don't need MSAA render targets on the GPU like
+// in the samples. The frames are uploaded straight to them
+// and the framebuffer is used to blit them to the mirror window
+struct EyeResolveFB {
+	GLuint resolve_fb;
+	GLuint resolve_texture;
+	// When rendering at a lower resolution the eye is uploaded here
+	// and upscaled to the resolve texture
+	GLuint upscale_fb;
+	GLuint upscale_texture;
+	// When submitting depth the ray distances are uploaded to the ray depth
+	// texture and converted to the eye's projection in the depth texture
+	GLuint ray_depth_texture;
+	GLuint depth_fb;
+	GLuint depth_texture;
+};
+
+/* Renders to the HMD through OpenVR, the frames are uploaded to GL textures,
+ * submitted to the compositor and mirrored to a window on the desktop
+ */
+class OpenVrBackend : public VrBackend {
+	SDL_Window *win;
+	SDL_GLContext ctx;
+	vr::IVRSystem *vr_system;
+	std::array<uint32_t, 2> vr_render_dims;
+	std::array<EyeParams, 2> eyes;
+	std::array<vr::TrackedDevicePose_t, vr::k_unMaxTrackedDeviceCount> tracked_device_poses;
+
+	// Released before the GL context is destroyed
+	std::unique_ptr<PboRing> upload_ring;
+	std::unique_ptr<FoveationUnwarp> unwarp;
+	std::unique_ptr<PboRing> depth_ring;
+	std::unique_ptr<RayDepthResolve> depth_resolve;
+	std::unique_ptr<GpuProfiler> gpu_profiler;
+	float foveation;
+	bool distortion_applied;
+	bool submit_depth;
+	std::array<vr::HmdMatrix44_t, 2> eye_projections;
+	std::array<EyeResolveFB, 2> eye_targets;
+	/* We predict the pose for when the frame will be shown, from a running estimate
+	 * of the time between getting the pose and submitting the frame rendered with it
+	 * plus the compositor's time to get it on the display
+	 */
+	bool predict_poses;
+	float frame_duration;
+	float vsync_to_photons;
+	double latency_estimate;
+	std::deque<std::chrono::steady_clock::time_point> pose_times;
+	// The vsync the frame rendered with the last pose should be shown at
+	std::chrono::steady_clock::time_point next_vsync;
+
+	PoseRecorder recorder;
+	PoseRecording replay;
+	size_t next_replay_pose;
+
+public:
+	OpenVrBackend();
+	~OpenVrBackend();
+	OpenVrBackend(const OpenVrBackend&) = delete;
+	OpenVrBackend& operator=(const OpenVrBackend&) = delete;
+
+	/* Open the window and connect to the HMD, if record_file isn't
+	 * empty the HMD poses are recorded to it for replaying later. If replay_file
+	 * isn't empty the poses in it are rendered in a loop instead of the
+	 * HMD's, while still presenting at the HMD's rate. If foveation is under 1 the
+	 * frames are rendered foveated by the VR camera and are unwarped before submitting.
+	 * If predict_poses is set the poses are predicted for when the frames rendered
+	 * with them will be shown, instead of using the compositor's prediction.
+	 * If submit_depth is set the frames' depth is submitted with them so the compositor
+	 * can reproject them, this isn't supported for foveated or pre-distorted frames
+	 */
+	bool init(const std::string &record_file, const std::string &replay_file, float foveation,
+			bool predict_poses, bool submit_depth);
+
+	std::array<uint32_t, 2> render_dims() const override;
+	EyeParams eye_params(size_t eye) const override;
+	bool apply_lens_distortion(const std::array<uint32_t, 2> &grid_dims,
+			std::vector<ospcommon::vec2f> &grid) override;
+	bool hidden_area_mesh(size_t eye, std::vector<ospcommon::vec2f> &triangles) const override;
+	bool poll_events() override;
+	bool wait_get_pose(ospcommon::AffineSpace3f &hmd_pose) override;
+	bool predicted_vsync(std::chrono::steady_clock::time_point &vsync) const override;
+	bool wants_depth() const override;
+	void submit(const uint32_t *image, const float *depth, const std::array<uint32_t, 2> &eye_dims,
+			const ospcommon::AffineSpace3f &hmd_pose, FrameTimes &times) override;
+	void show_status(const std::string &status) override;
+};
+
@@ -0,0 +1,55 @@
+#include "osp_state.h"
+
+OspObjectState::OspObjectState(OSPObject object) : object(object), changed(true) {}
+template<typename T, typename V>
+bool OspObjectState::update(std::map<std::string, T> &params, const std::string &name, const V &value) {
+	auto p = params.find(name);
+	if (p != params.end() && p->second == value) {
+		return false;
+	}
+	params[name] = value;
+	changed = true;
+	return true;
+}
+void OspObjectState::set1i(const std::string &name, int x) {
+	if (update(int_params, name, std::array<int, 2>{x, 0})) {
+		ospSet1i(object, name.c_str(), x);
+	}
+}
+void OspObjectState::set2i(const std::string &name, int x, int y) {
+	if (update(int_params, name, std::array<int, 2>{x, y})) {
+		ospSet2i(object, name.c_str(), x, y);
+	}
+}
+void OspObjectState::set1f(const std::string &name, float x) {
+	if (update(float_params, name, std::array<float, 3>{x, 0.f, 0.f})) {
+		ospSet1f(object, name.c_str(), x);
+	}
+}
+void OspObjectState::set2f(const std::string &name, float x, float y) {
+	if (update(float_params, name, std::array<float, 3>{x, y, 0.f})) {
+		ospSet2f(object, name.c_str(), x, y);
+	}
+}
+void OspObjectState::setVec3f(const std::string &name, const ospcommon::vec3f &v) {
+	if (update(float_params, name, std::array<float, 3>{v.x, v.y, v.z})) {
+		ospSet3f(object, name.c_str(), v.x, v.y, v.z);
+	}
+}
+void OspObjectState::setData(const std::string &name, OSPData data) {
+	// The object holds a reference to its data, so a new data can't have the address of the old one
+	if (update(object_params, name, static_cast<OSPObject>(data))) {
+		ospSetData(object, name.c_str(), data);
+	}
+}
+OSPObject OspObjectState::handle() const {
+	return object;
+}
+bool OspObjectState::commit() {
+	if (!changed) {
+		return false;
+	}
+	ospCommit(object);
+	changed = false;
+	return true;
+}
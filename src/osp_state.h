@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <string>
+#include <ospray/ospray.h>
+#include <ospcommon/vec.h>
+
+/* Wraps an OSPRay object to track the params set on it and only commit it when
+ * one of them actually changed. OSPRay redoes an object's whole setup on each
+ * commit, e.g. the VR camera recomputes each eye's projection, foveation and
+ * masks, so skipping redundant commits keeps the per frame overhead down. All the
+ * params of the object must be set through the wrapper to be tracked.
+ */
+class OspObjectState {
+	OSPObject object;
+	std::map<std::string, std::array<float, 3>> float_params;
+	std::map<std::string, std::array<int, 2>> int_params;
+	std::map<std::string, OSPObject> object_params;
+	bool changed;
+
+	template<typename T, typename V>
+	bool update(std::map<std::string, T> &params, const std::string &name, const V &value);
+
+public:
+	explicit OspObjectState(OSPObject object);
+
+	void set1i(const std::string &name, int x);
+	void set2i(const std::string &name, int x, int y);
+	void set1f(const std::string &name, float x);
+	void set2f(const std::string &name, float x, float y);
+	void setVec3f(const std::string &name, const ospcommon::vec3f &v);
+	void setData(const std::string &name, OSPData data);
+	// Commit the object if any of its params changed since the last commit,
+	// returns true if it was committed
+	bool commit();
+	// The wrapped object, for the calls which take it like ospRenderFrame
+	OSPObject handle() const;
+};
+
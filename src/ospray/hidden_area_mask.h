@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/* Shared by the VR camera and the app, so the app knows exactly which pixels
+ * the camera may have given empty rays for being hidden by the lens
+ */
+namespace ospvr {
+	// Cells along each axis of an eye's hidden area mask
+	static const int HIDDEN_MASK_DIM = 512;
+
+	/* Rasterize a hidden area mesh, a list of triangles in [0, 1] image coordinates
+	 * with the first row at the bottom, into the dim x dim mask by setting the cells
+	 * which lie entirely inside one of the triangles. Every set cell is hidden, a
+	 * cell only covered by several triangles together is left clear which just
+	 * traces a few more rays. The camera only skips the screen cells which map to
+	 * set cells, so these are a superset of the cells it skips
+	 */
+	template<typename Vec2>
+	inline void rasterizeHiddenArea(const Vec2 *verts, size_t numVerts, int dim, uint8_t *mask) {
+		for (size_t t = 0; t + 2 < numVerts; t += 3) {
+			const Vec2 &a = verts[t];
+			const Vec2 &b = verts[t + 1];
+			const Vec2 &c = verts[t + 2];
+			const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if (area == 0.f) {
+				continue;
+			}
+			// Flip the edge tests for clockwise triangles
+			auto inside = [&](float px, float py) {
+				return ((b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x)) * area >= 0.f
+					&& ((c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x)) * area >= 0.f
+					&& ((a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x)) * area >= 0.f;
+			};
+			const int x_lo = std::max(static_cast<int>(std::min({a.x, b.x, c.x}) * dim), 0);
+			const int y_lo = std::max(static_cast<int>(std::min({a.y, b.y, c.y}) * dim), 0);
+			const int x_hi = std::min(static_cast<int>(std::max({a.x, b.x, c.x}) * dim) + 1, dim);
+			const int y_hi = std::min(static_cast<int>(std::max({a.y, b.y, c.y}) * dim) + 1, dim);
+			for (int y = y_lo; y < y_hi; ++y) {
+				const float py0 = static_cast<float>(y) / dim;
+				const float py1 = static_cast<float>(y + 1) / dim;
+				for (int x = x_lo; x < x_hi; ++x) {
+					// The triangle is convex, so the cell is inside it if all its corners are
+					const float px0 = static_cast<float>(x) / dim;
+					const float px1 = static_cast<float>(x + 1) / dim;
+					if (inside(px0, py0) && inside(px1, py0) && inside(px0, py1) && inside(px1, py1)) {
+						mask[y * dim + x] = 1;
+					}
+				}
+			}
+		}
+	}
+}
+
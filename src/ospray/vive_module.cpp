@@ -1,9 +1,16 @@
 #include <iostream>
 #include "common/OSPCommon.h"
+#include "vr_load_balancer.h"
 
 namespace ospvr {
 	extern "C" OSPRAY_DLLEXPORT void ospray_init_module_vive() {
 		std::cout << "Loading OSPRay Vive module\n";
+		// Skip the tiles hidden by the HMD's lenses when rendering locally, the
+		// distributed load balancers are left as is
+		if (dynamic_cast<LocalTiledLoadBalancer*>(TiledLoadBalancer::instance)) {
+			delete TiledLoadBalancer::instance;
+			TiledLoadBalancer::instance = new VrTiledLoadBalancer();
+		}
 	}
 }
 
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <stdexcept>
+#include "hidden_area_mask.h"
 #include "vr_camera.h"
 // We just use the Vr camera but tweak it
 #include "vr_camera_ispc.h"
@@ -9,7 +13,28 @@
 #endif
 
 namespace ospvr {
-	VrCamera::VrCamera() {
+	// Pixels along each side of the cells the reuse mask is summarized in
+	static const int REUSE_CELL_SIZE = 8;
+
+	/* Check if all the cells of a w x h mask overlapped by the region between lo and hi,
+	 * in [0, 1] coordinates over the mask, are set, using the mask's summed area table
+	 */
+	static bool cellsCovered(const uint32_t *sums, int w, int h, float x_lo, float y_lo,
+			float x_hi, float y_hi)
+	{
+		const int cx_lo = std::max(static_cast<int>(x_lo * w), 0);
+		const int cy_lo = std::max(static_cast<int>(y_lo * h), 0);
+		const int cx_hi = std::min(static_cast<int>(std::ceil(x_hi * w)), w);
+		const int cy_hi = std::min(static_cast<int>(std::ceil(y_hi * h)), h);
+		const int stride = w + 1;
+		const uint32_t set = sums[cy_hi * stride + cx_hi] - sums[cy_lo * stride + cx_hi]
+			- sums[cy_hi * stride + cx_lo] + sums[cy_lo * stride + cx_lo];
+		return set == static_cast<uint32_t>((cx_hi - cx_lo) * (cy_hi - cy_lo));
+	}
+
+	VrCamera::VrCamera() : stereo(false), foveation(1.f), tracedEyes(3), maskStereo(false),
+		maskFoveation(1.f)
+	{
 		ispcEquivalent = ispc::VrCamera_create(this);
 	}
 
@@ -20,23 +45,292 @@ namespace ospvr {
 	void VrCamera::commit() {
 		Camera::commit();
 
+		stereo = getParam1i("stereo", 0) != 0;
+
 		// Get the params for the lowerleft and upperleft params we take
-		lowerLeft = getParam2f("lowerLeft", vec2f(0.f, 0.f));
-		upperRight = getParam2f("upperRight", vec2f(1.f, 1.f));
+		eyePos[0] = pos;
+		lowerLeft[0] = getParam2f("lowerLeft", vec2f(0.f, 0.f));
+		upperRight[0] = getParam2f("upperRight", vec2f(1.f, 1.f));
+		if (stereo) {
+			eyePos[0] = getParam3f("leftPos", pos);
+			eyePos[1] = getParam3f("rightPos", pos);
+			lowerLeft[1] = getParam2f("rightLowerLeft", lowerLeft[0]);
+			upperRight[1] = getParam2f("rightUpperRight", upperRight[0]);
+			lowerLeft[0] = getParam2f("leftLowerLeft", lowerLeft[0]);
+			upperRight[0] = getParam2f("leftUpperRight", upperRight[0]);
+		} else {
+			eyePos[1] = eyePos[0];
+			lowerLeft[1] = lowerLeft[0];
+			upperRight[1] = upperRight[0];
+		}
 
 		dir = normalize(dir);
-		vec3f dir_du = normalize(cross(dir, up));
-		vec3f dir_dv = cross(dir_du, dir);
+		const vec3f cam_du = normalize(cross(dir, up));
+		const vec3f cam_dv = cross(cam_du, dir);
 
-		vec3f org = pos;
-		vec3f dir_00 = dir + lowerLeft.x*dir_du + lowerLeft.y*dir_dv;
+		vec3f org[2];
+		vec3f dir_00[2];
+		vec3f dir_du[2];
+		vec3f dir_dv[2];
+		for (size_t i = 0; i < 2; ++i) {
+			org[i] = eyePos[i];
+			dir_00[i] = dir + lowerLeft[i].x * cam_du + lowerLeft[i].y * cam_dv;
+			dir_du[i] = cam_du * (upperRight[i].x - lowerLeft[i].x);
+			dir_dv[i] = cam_dv * (upperRight[i].y - lowerLeft[i].y);
+		}
 
-		dir_du *= upperRight.x - lowerLeft.x;
-		dir_dv *= upperRight.y - lowerLeft.y;
+		ispc::VrCamera_set(getIE(), stereo, (const ispc::vec3f*)org,
+				(const ispc::vec3f*)dir_00, (const ispc::vec3f*)dir_du,
+				(const ispc::vec3f*)dir_dv);
 
-		ispc::VrCamera_set(getIE(), (const ispc::vec3f&)org,
-				(const ispc::vec3f&)dir_00, (const ispc::vec3f&)dir_du,
-				(const ispc::vec3f&)dir_dv);
+		/* Each axis of the eye's image is warped separately about the center of the
+		 * projection c, a foveated coordinate s maps to c + f * t * (1 + k * t^2) with
+		 * t = s - c. So the center keeps the unwarped sample density, and k is picked
+		 * on each side of the center so the edges of the framebuffer map to the edges
+		 * of the image. This keeps the image rectangular and the unwarp separable
+		 */
+		foveation = std::min(std::max(getParam1f("foveation", 1.f), 0.1f), 1.f);
+		const float stretch = 1.f / foveation - 1.f;
+		for (size_t i = 0; i < 2; ++i) {
+			for (size_t j = 0; j < 2; ++j) {
+				const float c = -lowerLeft[i][j] / (upperRight[i][j] - lowerLeft[i][j]);
+				foveaCenter[i][j] = std::min(std::max(c, 0.05f), 0.95f);
+				foveaCoefLo[i][j] = stretch / (foveaCenter[i][j] * foveaCenter[i][j]);
+				foveaCoefHi[i][j] = stretch / ((1.f - foveaCenter[i][j]) * (1.f - foveaCenter[i][j]));
+			}
+		}
+		ispc::VrCamera_setFoveation(getIE(), foveation, (const ispc::vec2f*)foveaCenter,
+				(const ispc::vec2f*)foveaCoefLo, (const ispc::vec2f*)foveaCoefHi);
+
+		// We hold a reference to the lens distortion grid so the ISPC side can use it directly
+		distortionGrid = getParamData("distortionGrid", nullptr);
+		distortionGridSize = getParam2i("distortionGridSize", vec2i(0, 0));
+		if (distortionGrid && (distortionGridSize.x < 2 || distortionGridSize.y < 2
+					|| distortionGrid->type != OSP_FLOAT2
+					|| distortionGrid->numItems != size_t(2 * distortionGridSize.x * distortionGridSize.y)))
+		{
+			throw std::runtime_error("VrCamera: distortionGrid must have distortionGridSize"
+					" OSP_FLOAT2 points for each eye");
+		}
+		ispc::VrCamera_setDistortion(getIE(),
+				distortionGrid ? (ispc::vec2f*)distortionGrid->data : nullptr,
+				(const ispc::vec2i&)distortionGridSize);
+
+		hiddenArea[0] = getParamData("leftHiddenArea", nullptr);
+		hiddenArea[1] = getParamData("rightHiddenArea", nullptr);
+		for (size_t i = 0; i < 2; ++i) {
+			if (hiddenArea[i] && (hiddenArea[i]->type != OSP_FLOAT2 || hiddenArea[i]->numItems % 3 != 0)) {
+				throw std::runtime_error("VrCamera: the hidden areas must be lists of OSP_FLOAT2 triangles");
+			}
+		}
+		updateHiddenMask();
+
+		// The reuse mask is only read when tracing the right eye, the app may have
+		// replaced the memory it shares with us since the last frame it was used for
+		tracedEyes = getParam1i("tracedEyes", 3);
+		reuseMask = getParamData("rightReuseMask", nullptr);
+		reuseMaskSize = getParam2i("reuseMaskSize", vec2i(0, 0));
+		if (!stereo || (tracedEyes & 2) == 0) {
+			reuseMask = nullptr;
+		}
+		if (reuseMask && (reuseMaskSize.x < 1 || reuseMaskSize.y < 1 || reuseMask->type != OSP_UCHAR
+					|| reuseMask->numItems != size_t(reuseMaskSize.x * reuseMaskSize.y)))
+		{
+			throw std::runtime_error("VrCamera: rightReuseMask must have reuseMaskSize OSP_UCHAR values");
+		}
+		updateReuseCells();
+		ispc::VrCamera_setReuse(getIE(), tracedEyes,
+				reuseMask ? (uint8_t*)reuseMask->data : nullptr,
+				(const ispc::vec2i&)reuseMaskSize);
+	}
+	bool VrCamera::regionHidden(const vec2f &lo, const vec2f &hi) const {
+		// Check the part of the region in each eye's half of the framebuffer, each part
+		// must be untraced, reprojected or hidden by the lens
+		const int num_eyes = stereo ? 2 : 1;
+		for (int eye = 0; eye < num_eyes; ++eye) {
+			float x_lo = lo.x;
+			float x_hi = hi.x;
+			if (stereo) {
+				x_lo = std::max(2.f * x_lo - eye, 0.f);
+				x_hi = std::min(2.f * x_hi - eye, 1.f);
+				if (x_lo >= x_hi) {
+					continue;
+				}
+			}
+			if ((tracedEyes & (1 << eye)) == 0) {
+				continue;
+			}
+			if (eye == 1 && !reuseCellSums.empty()
+					&& cellsCovered(reuseCellSums.data(), reuseCells.x, reuseCells.y, x_lo, lo.y, x_hi, hi.y))
+			{
+				continue;
+			}
+			if (hiddenMask.empty()) {
+				return false;
+			}
+			const int w = HIDDEN_MASK_DIM + 1;
+			if (!cellsCovered(&hiddenMaskSums[eye * w * w], HIDDEN_MASK_DIM, HIDDEN_MASK_DIM,
+						x_lo, lo.y, x_hi, hi.y))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+	int VrCamera::projectionCenters(vec2f centers[2]) const {
+		if (!stereo) {
+			centers[0] = foveaCenter[0];
+			return 1;
+		}
+		for (int eye = 0; eye < 2; ++eye) {
+			centers[eye] = vec2f((eye + foveaCenter[eye].x) * 0.5f, foveaCenter[eye].y);
+		}
+		return 2;
+	}
+	vec2f VrCamera::foveate(size_t eye, const vec2f &screen) const {
+		if (foveation >= 1.f) {
+			return screen;
+		}
+		vec2f s = screen;
+		for (size_t j = 0; j < 2; ++j) {
+			const float t = screen[j] - foveaCenter[eye][j];
+			const float coef = t < 0.f ? foveaCoefLo[eye][j] : foveaCoefHi[eye][j];
+			s[j] = foveaCenter[eye][j] + foveation * t * (1.f + coef * t * t);
+		}
+		return s;
+	}
+	vec2f VrCamera::distort(size_t eye, const vec2f &screen) const {
+		const int w = distortionGridSize.x;
+		const int h = distortionGridSize.y;
+		const vec2f *grid = static_cast<const vec2f*>(distortionGrid->data) + eye * w * h;
+		const float fx = std::min(std::max(screen.x, 0.f), 1.f) * (w - 1);
+		const float fy = std::min(std::max(screen.y, 0.f), 1.f) * (h - 1);
+		const int x = std::min(static_cast<int>(fx), w - 2);
+		const int y = std::min(static_cast<int>(fy), h - 2);
+		const float tx = fx - x;
+		const float ty = fy - y;
+		const vec2f lo = (1.f - tx) * grid[y * w + x] + tx * grid[y * w + x + 1];
+		const vec2f hi = (1.f - tx) * grid[(y + 1) * w + x] + tx * grid[(y + 1) * w + x + 1];
+		return (1.f - ty) * lo + ty * hi;
+	}
+	void VrCamera::updateHiddenMask() {
+		bool changed = stereo != maskStereo || foveation != maskFoveation
+			|| distortionGrid.ptr != maskDistortionGrid.ptr;
+		for (size_t i = 0; i < 2; ++i) {
+			changed = changed || hiddenArea[i].ptr != maskHiddenArea[i].ptr
+				|| lowerLeft[i] != maskLowerLeft[i] || upperRight[i] != maskUpperRight[i];
+		}
+		if (!changed) {
+			return;
+		}
+		maskStereo = stereo;
+		maskFoveation = foveation;
+		maskDistortionGrid = distortionGrid;
+		for (size_t i = 0; i < 2; ++i) {
+			maskHiddenArea[i] = hiddenArea[i];
+			maskLowerLeft[i] = lowerLeft[i];
+			maskUpperRight[i] = upperRight[i];
+		}
+		hiddenMask.clear();
+		hiddenMaskSums.clear();
+		if (!hiddenArea[0] && !hiddenArea[1] && !distortionGrid) {
+			ispc::VrCamera_setHiddenMask(getIE(), nullptr, 0);
+			return;
+		}
+
+		const int dim = HIDDEN_MASK_DIM;
+		const int num_eyes = stereo ? 2 : 1;
+		hiddenMask.resize(2 * dim * dim, 0);
+		hiddenMaskSums.resize(2 * (dim + 1) * (dim + 1), 0);
+		std::vector<uint8_t> image_hidden;
+		std::vector<uint32_t> image_sums((dim + 1) * (dim + 1), 0);
+		std::vector<vec2f> corners((dim + 1) * (dim + 1));
+		// The foveation and lens distortion bend the screen cells' edges a little when
+		// mapping them to the image, so the image cells around their bounds are checked too
+		const int pad = foveation < 1.f || distortionGrid ? 1 : 0;
+		for (int eye = 0; eye < num_eyes; ++eye) {
+			// Rasterize the hidden area mesh into a mask over the eye's image
+			image_hidden.assign(dim * dim, 0);
+			if (hiddenArea[eye]) {
+				rasterizeHiddenArea(static_cast<const vec2f*>(hiddenArea[eye]->data),
+						hiddenArea[eye]->numItems, dim, image_hidden.data());
+			}
+			for (int y = 0; y < dim; ++y) {
+				for (int x = 0; x < dim; ++x) {
+					image_sums[(y + 1) * (dim + 1) + x + 1] = image_hidden[y * dim + x]
+						+ image_sums[y * (dim + 1) + x + 1] + image_sums[(y + 1) * (dim + 1) + x]
+						- image_sums[y * (dim + 1) + x];
+				}
+			}
+
+			// Map the corners of each screen cell through the foveation and lens distortion
+			// to the image
+			for (int y = 0; y <= dim; ++y) {
+				for (int x = 0; x <= dim; ++x) {
+					vec2f p = foveate(eye, vec2f(static_cast<float>(x) / dim, static_cast<float>(y) / dim));
+					if (distortionGrid) {
+						p = distort(eye, p);
+					}
+					corners[y * (dim + 1) + x] = p;
+				}
+			}
+			/* A screen cell is hidden if all the image cells it maps to are, the parts
+			 * of it mapped outside the image are never seen
+			 */
+			uint8_t *mask = &hiddenMask[eye * dim * dim];
+			uint32_t *sums = &hiddenMaskSums[eye * (dim + 1) * (dim + 1)];
+			for (int y = 0; y < dim; ++y) {
+				for (int x = 0; x < dim; ++x) {
+					const vec2f *c = &corners[y * (dim + 1) + x];
+					const vec2f lo = min(min(c[0], c[1]), min(c[dim + 1], c[dim + 2]));
+					const vec2f hi = max(max(c[0], c[1]), max(c[dim + 1], c[dim + 2]));
+					bool hidden = true;
+					if (hi.x > 0.f && lo.x < 1.f && hi.y > 0.f && lo.y < 1.f) {
+						const int x0 = std::max(static_cast<int>(std::floor(lo.x * dim)) - pad, 0);
+						const int y0 = std::max(static_cast<int>(std::floor(lo.y * dim)) - pad, 0);
+						const int x1 = std::max(std::min(static_cast<int>(std::ceil(hi.x * dim)) + pad, dim), x0 + 1);
+						const int y1 = std::max(std::min(static_cast<int>(std::ceil(hi.y * dim)) + pad, dim), y0 + 1);
+						const uint32_t num_hidden = image_sums[y1 * (dim + 1) + x1] - image_sums[y0 * (dim + 1) + x1]
+							- image_sums[y1 * (dim + 1) + x0] + image_sums[y0 * (dim + 1) + x0];
+						hidden = num_hidden == static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+					}
+					mask[y * dim + x] = hidden;
+					sums[(y + 1) * (dim + 1) + x + 1] = mask[y * dim + x] + sums[y * (dim + 1) + x + 1]
+						+ sums[(y + 1) * (dim + 1) + x] - sums[y * (dim + 1) + x];
+				}
+			}
+		}
+		ispc::VrCamera_setHiddenMask(getIE(), hiddenMask.data(), dim);
+	}
+	void VrCamera::updateReuseCells() {
+		reuseCellSums.clear();
+		if (!reuseMask) {
+			return;
+		}
+		// A cell is reused if all its pixels are, the cells on the right and top
+		// edges may be partially outside the image
+		const int w = reuseMaskSize.x;
+		const int h = reuseMaskSize.y;
+		reuseCells = vec2i((w + REUSE_CELL_SIZE - 1) / REUSE_CELL_SIZE, (h + REUSE_CELL_SIZE - 1) / REUSE_CELL_SIZE);
+		std::vector<uint8_t> cells(reuseCells.x * reuseCells.y, 1);
+		const uint8_t *mask = static_cast<const uint8_t*>(reuseMask->data);
+		for (int y = 0; y < h; ++y) {
+			uint8_t *cell_row = &cells[(y / REUSE_CELL_SIZE) * reuseCells.x];
+			for (int x = 0; x < w; ++x) {
+				if (!mask[y * w + x]) {
+					cell_row[x / REUSE_CELL_SIZE] = 0;
+				}
+			}
+		}
+		const int stride = reuseCells.x + 1;
+		reuseCellSums.resize(stride * (reuseCells.y + 1), 0);
+		for (int y = 0; y < reuseCells.y; ++y) {
+			for (int x = 0; x < reuseCells.x; ++x) {
+				reuseCellSums[(y + 1) * stride + x + 1] = cells[y * reuseCells.x + x]
+					+ reuseCellSums[y * stride + x + 1] + reuseCellSums[(y + 1) * stride + x]
+					- reuseCellSums[y * stride + x];
+			}
+		}
 	}
 
 	OSP_REGISTER_CAMERA(VrCamera, vr);
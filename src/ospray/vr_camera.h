@@ -1,19 +1,95 @@
 #pragma once
 
+#include <vector>
 #include "camera/Camera.h"
+#include "common/Data.h"
 
 namespace ospvr {
 	using namespace ospray;
 
+	/* The VR camera renders either a single eye (the default) or, when
+	 * the "stereo" param is set, both eyes side by side in one framebuffer.
+	 * In stereo mode the left half of the image is the left eye and the
+	 * right half the right eye, each eye takes its own position and image plane
+	 * bounds through the left/right prefixed params, eg. "leftPos", "rightLowerLeft"
+	 *
+	 * Setting "foveation" below 1 renders a foveated image, where the framebuffer is
+	 * "foveation" times the size of the image along each axis and the rays are spread
+	 * out towards the edges. The center of each eye's projection keeps the full sample
+	 * density while the edges get the least, the app unwarps the frame to the full image.
+	 *
+	 * To trace the image as it's shown through the HMD's lenses "distortionGrid" can be
+	 * set to a lookup grid of "distortionGridSize" points (vec2i) per eye, the left eye's
+	 * points followed by the right's, each row from the bottom of the image up. Each point
+	 * is the coordinate in the undistorted [0, 1] image of that point on the display,
+	 * points outside [0, 1] aren't visible and aren't traced.
+	 *
+	 * The parts of each eye's image hidden by the lens can be set through "leftHiddenArea"
+	 * and "rightHiddenArea", the HMD's hidden area mesh as a list of triangles (vec2f) in
+	 * [0, 1] image coordinates with the first row at the bottom. The pixels hidden by the
+	 * mesh, or outside the lens when tracing the distortion, aren't traced and the load
+	 * balancer skips tiles which are entirely hidden.
+	 *
+	 * To reuse one eye's samples for the other "tracedEyes" picks the eyes which are
+	 * traced, bit 0 for the left and bit 1 for the right (default 3, both). When tracing
+	 * the right eye "rightReuseMask" can be set to a mask of "reuseMaskSize" (vec2i) bytes
+	 * over its pixels, with the first row at the bottom, where the pixels the app has
+	 * reprojected from the left eye are non-zero. Those pixels get empty rays and are
+	 * left for the app to fill in, tiles of untraced or reprojected pixels are skipped.
+	 */
 	struct VrCamera : public Camera {
 		VrCamera();
 		virtual ~VrCamera() = default;
 
 		virtual std::string toString() const override;
 		virtual void commit() override;
+		/* Check if the region of the framebuffer between lo and hi, in [0, 1] coordinates
+		 * over the whole framebuffer, is entirely hidden by the lens
+		 */
+		bool regionHidden(const vec2f &lo, const vec2f &hi) const;
+		/* Get the centers of the projections of the eyes in the framebuffer, in [0, 1]
+		 * coordinates over the whole framebuffer, returns the number of eyes
+		 */
+		int projectionCenters(vec2f centers[2]) const;
 
-		vec2f lowerLeft;
-		vec2f upperRight;
+		bool stereo;
+		vec3f eyePos[2];
+		vec2f lowerLeft[2];
+		vec2f upperRight[2];
+		float foveation;
+		Ref<Data> distortionGrid;
+		vec2i distortionGridSize;
+		Ref<Data> hiddenArea[2];
+		int tracedEyes;
+		Ref<Data> reuseMask;
+		vec2i reuseMaskSize;
+
+	private:
+		vec2f foveaCenter[2];
+		vec2f foveaCoefLo[2];
+		vec2f foveaCoefHi[2];
+		/* The mask of the cells of each eye's screen which are entirely hidden, and the
+		 * summed area table of the mask to check regions. Rebuilt when the params it
+		 * depends on change
+		 */
+		std::vector<uint8_t> hiddenMask;
+		std::vector<uint32_t> hiddenMaskSums;
+		bool maskStereo;
+		float maskFoveation;
+		vec2f maskLowerLeft[2];
+		vec2f maskUpperRight[2];
+		Ref<Data> maskDistortionGrid;
+		Ref<Data> maskHiddenArea[2];
+		/* The cells of the right eye's pixels which are all reprojected, and the summed
+		 * area table of them to check regions. Rebuilt each commit when tracing the right eye
+		 */
+		std::vector<uint32_t> reuseCellSums;
+		vec2i reuseCells;
+
+		vec2f foveate(size_t eye, const vec2f &screen) const;
+		vec2f distort(size_t eye, const vec2f &screen) const;
+		void updateHiddenMask();
+		void updateReuseCells();
 	};
 
 }
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "common/tasking/parallel_for.h"
+#include "fb/FrameBuffer.h"
+#include "fb/LocalFB.h"
+#include "render/Renderer.h"
+#include "vr_camera.h"
+#include "vr_load_balancer.h"
+#ifdef OSPRAY_TASKING_TBB
+#include <tbb/task_group.h>
+#if TBB_INTERFACE_VERSION >= 12000
+#include <tbb/info.h>
+#endif
+#endif
+
+namespace ospvr {
+	/* Order the framebuffer's tiles by the distance from their center to the nearest
+	 * eye's projection center, so the tiles in the middle of the view are started first
+	 */
+	static std::vector<int> centerOutOrder(const VrCamera *camera, const FrameBuffer *fb) {
+		vec2f centers[2] = {vec2f(0.5f), vec2f(0.5f)};
+		const int numCenters = camera ? camera->projectionCenters(centers) : 1;
+		const vec2f fbSize(fb->size);
+		for (int i = 0; i < numCenters; ++i) {
+			centers[i] = centers[i] * fbSize;
+		}
+
+		const vec2i numTiles = fb->getNumTiles();
+		std::vector<std::pair<float, int>> tiles(fb->getTotalTiles());
+		for (int i = 0; i < fb->getTotalTiles(); ++i) {
+			const vec2i tileID(i % numTiles.x, i / numTiles.x);
+			const vec2f tileCenter = vec2f(tileID * TILE_SIZE) + vec2f(TILE_SIZE * 0.5f);
+			float dist = std::numeric_limits<float>::infinity();
+			for (int c = 0; c < numCenters; ++c) {
+				const vec2f d = tileCenter - centers[c];
+				dist = std::min(dist, dot(d, d));
+			}
+			tiles[i] = std::make_pair(dist, i);
+		}
+		std::sort(tiles.begin(), tiles.end());
+		std::vector<int> order(tiles.size());
+		for (size_t i = 0; i < tiles.size(); ++i) {
+			order[i] = tiles[i].second;
+		}
+		return order;
+	}
+
+	// The last frame's pixels to copy the tiles skipped at the deadline from
+	struct PreviousFrame {
+		const uint32 *color;
+		const float *depth;
+	};
+
+	/* Get the renderer's "previousColor" and "previousDepth" if they're the size of fb, the
+	 * color is copied as is so it has to be a RGBA8 or SRGBA framebuffer. The depth is
+	 * optional. Returns false if there's no previous frame to copy the skipped tiles from
+	 */
+	static bool previousFrame(Renderer *renderer, const LocalFrameBuffer *fb, PreviousFrame &prev) {
+		const size_t numPixels = static_cast<size_t>(fb->size.x) * fb->size.y;
+		const Data *color = renderer->getParamData("previousColor", nullptr);
+		const Data *depth = renderer->getParamData("previousDepth", nullptr);
+		if (!color || color->numItems != numPixels
+				|| (fb->colorBufferFormat != OSP_FB_RGBA8 && fb->colorBufferFormat != OSP_FB_SRGBA))
+		{
+			return false;
+		}
+		prev.color = static_cast<const uint32*>(color->data);
+		prev.depth = fb->depthBuffer && depth && depth->numItems == numPixels
+			? static_cast<const float*>(depth->data) : nullptr;
+		return true;
+	}
+
+	// Copy the tile's color and depth from the previous frame
+	static void copyTile(const PreviousFrame &prev, LocalFrameBuffer *fb, const vec2i &tileID) {
+		const vec2i lo = tileID * TILE_SIZE;
+		const vec2i hi = min(lo + vec2i(TILE_SIZE), fb->size);
+		const size_t count = hi.x - lo.x;
+		for (int y = lo.y; y < hi.y; ++y) {
+			const size_t offset = static_cast<size_t>(y) * fb->size.x + lo.x;
+			std::memcpy(static_cast<uint32*>(fb->colorBuffer) + offset, prev.color + offset,
+					count * sizeof(uint32));
+			if (prev.depth) {
+				std::memcpy(fb->depthBuffer + offset, prev.depth + offset, count * sizeof(float));
+			}
+		}
+	}
+
+	float VrTiledLoadBalancer::renderFrame(Renderer *renderer, FrameBuffer *fb, const uint32 channelFlags) {
+		using namespace std::chrono;
+		const VrCamera *camera = dynamic_cast<const VrCamera*>(renderer->getParamObject("camera", nullptr));
+		// Milliseconds after the start of the frame to stop starting tiles at, 0 to render them all.
+		// Without a previous frame to fill the skipped tiles from they're all rendered
+		LocalFrameBuffer *localFb = dynamic_cast<LocalFrameBuffer*>(fb);
+		PreviousFrame prevFrame;
+		const float deadline = localFb && previousFrame(renderer, localFb, prevFrame)
+			? renderer->getParam1f("frameDeadline", 0.f) : 0.f;
+		const steady_clock::time_point deadlineTime = steady_clock::now()
+			+ duration_cast<steady_clock::duration>(duration<float, std::milli>(deadline));
+
+		/* The tasks take the tiles in center-out order instead of their own, so the
+		 * tiles the viewer is most likely looking at are rendered first and the ones
+		 * left out after the deadline are towards the edges of the view
+		 */
+		const std::vector<int> order = centerOutOrder(camera, fb);
+		const int numTiles_x = fb->getNumTiles().x;
+
+		void *perFrameData = renderer->beginFrame(fb);
+		auto renderTile = [&](const int taskIndex) {
+			const vec2i tileID(taskIndex % numTiles_x, taskIndex / numTiles_x);
+			if (fb->tileError(tileID) <= renderer->errorThreshold) {
+				return;
+			}
+			// The hidden tiles are never seen and the app fills in the untraced or reprojected
+			// ones, so we leave whatever was in the framebuffer
+			if (camera) {
+				const vec2f lo = vec2f(tileID * TILE_SIZE) / vec2f(fb->size);
+				const vec2f hi = vec2f(min((tileID + vec2i(1)) * TILE_SIZE, fb->size)) / vec2f(fb->size);
+				if (camera->regionHidden(lo, hi)) {
+					return;
+				}
+			}
+			// Past the deadline the tile is copied from the previous frame, which is from the
+			// last pose and at the edges of the view, that's better than missing the vsync
+			if (deadline > 0.f && steady_clock::now() > deadlineTime) {
+				copyTile(prevFrame, localFb, tileID);
+				return;
+			}
+
+			Tile __aligned(64) tile(tileID, fb->size, fb->accumID(tileID));
+			tasking::parallel_for(TILE_SIZE * TILE_SIZE / RENDERTILE_PIXELS_PER_JOB, [&](int jobID) {
+				renderer->renderTile(perFrameData, tile, jobID);
+			});
+			fb->setTile(tile);
+		};
+#ifdef OSPRAY_TASKING_TBB
+		// Only worth it when both eyes are traced, the stereo reuse passes trace one
+		const bool splitEyes = camera && camera->stereo && camera->tracedEyes == 3
+			&& renderer->getParam1i("splitEyes", 0) != 0;
+		if (splitEyes) {
+			// The left eye is the left half of the framebuffer, each eye keeps its tiles center-out
+			std::vector<int> eyeOrder[2];
+			for (const int t : order) {
+				const int x = (t % numTiles_x) * TILE_SIZE + TILE_SIZE / 2;
+				eyeOrder[x >= fb->size.x / 2 ? 1 : 0].push_back(t);
+			}
+			auto renderEye = [&](const int eye) {
+				std::atomic<int> nextTile(0);
+				tasking::parallel_for(static_cast<int>(eyeOrder[eye].size()), [&](int) {
+					renderTile(eyeOrder[eye][nextTile++]);
+				});
+			};
+			initEyeArenas();
+			// The right eye runs in its arena's workers while this thread joins the left eye's
+			tbb::task_group rightEye;
+			eyeArenas[1]->execute([&]() { rightEye.run([&]() { renderEye(1); }); });
+			eyeArenas[0]->execute([&]() { renderEye(0); });
+			eyeArenas[1]->execute([&]() { rightEye.wait(); });
+		} else
+#endif
+		{
+			std::atomic<int> nextTile(0);
+			tasking::parallel_for(fb->getTotalTiles(), [&](int) {
+				renderTile(order[nextTile++]);
+			});
+		}
+		renderer->endFrame(perFrameData, channelFlags);
+		return fb->endFrame(renderer->errorThreshold);
+	}
+#ifdef OSPRAY_TASKING_TBB
+	void VrTiledLoadBalancer::initEyeArenas() {
+		if (eyeArenas[0]) {
+			return;
+		}
+#if TBB_INTERFACE_VERSION >= 12000
+		// Pin each eye to its own NUMA node's threads when there's more than one
+		const std::vector<tbb::numa_node_id> nodes = tbb::info::numa_nodes();
+		if (nodes.size() >= 2) {
+			for (int i = 0; i < 2; ++i) {
+				eyeArenas[i] = std::make_unique<tbb::task_arena>(tbb::task_arena::constraints(nodes[i]));
+			}
+			return;
+		}
+#endif
+		const int threads = std::max(tbb::this_task_arena::max_concurrency() / 2, 1);
+		for (int i = 0; i < 2; ++i) {
+			eyeArenas[i] = std::make_unique<tbb::task_arena>(threads);
+		}
+	}
+#endif
+	std::string VrTiledLoadBalancer::toString() const {
+		return "ospvr::VrTiledLoadBalancer";
+	}
+}
+
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "render/LoadBalancer.h"
+#ifdef OSPRAY_TASKING_TBB
+#include <memory>
+#include <tbb/task_arena.h>
+#endif
+
+namespace ospvr {
+	using namespace ospray;
+
+	/* Replaces OSPRay's local tiled load balancer to skip the tiles that
+	 * aren't visible in the HMD. When rendering with a VR camera which has
+	 * a hidden area mask the tiles it hides entirely aren't rendered, otherwise
+	 * it renders the frame like the local load balancer.
+	 *
+	 * The tiles are rendered center-out from the eyes' projection centers. If the
+	 * renderer has a "frameDeadline" (milliseconds after the render starts, default 0
+	 * for none) the tiles not started by then are copied from the "previousColor" and
+	 * "previousDepth" data instead, the last frame's pixels in the framebuffer's layout.
+	 * So a slow frame shows the last frame at its edges instead of missing the HMD's
+	 * vsync. Without a previous frame of the framebuffer's size the deadline is ignored.
+	 * The app sets the deadline for each frame from the time left until its vsync.
+	 *
+	 * When OSPRay uses TBB and the renderer's "splitEyes" is set, the eyes of a stereo
+	 * VR camera tracing both eyes are rendered at the same time in their own task arenas,
+	 * each with half the worker threads. With oneTBB on a machine with two or more NUMA
+	 * nodes each eye's arena is pinned to its own node instead, so an eye's tiles are
+	 * traced by the threads of one socket. It's ignored without TBB.
+	 */
+	struct VrTiledLoadBalancer : public TiledLoadBalancer {
+		float renderFrame(Renderer *renderer, FrameBuffer *fb, const uint32 channelFlags) override;
+		std::string toString() const override;
+
+	private:
+#ifdef OSPRAY_TASKING_TBB
+		// The task arena of each eye for "splitEyes", created on first use
+		std::unique_ptr<tbb::task_arena> eyeArenas[2];
+
+		void initEyeArenas();
+#endif
+	};
+
+}
+
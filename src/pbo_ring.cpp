@@ -0,0 +1,102 @@
+#include <iostream>
+#include <SDL.h>
+#include "pbo_ring.h"
+
+// GL_ARB_buffer_storage isn't part of the 3.3 core loader so we load it ourselves
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (CODEGEN_FUNCPTR *BufferStorageFn)(GLenum, GLsizeiptr, const void*, GLbitfield);
+
+PboRing::PboRing() : pbo(0), slot_size(0), current(0), persistent_map(nullptr) {}
+PboRing::~PboRing() {
+	for (auto &s : slots) {
+		if (s.fence) {
+			glDeleteSync(s.fence);
+		}
+	}
+	if (pbo) {
+		if (persistent_map) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &pbo);
+	}
+}
+bool PboRing::init(size_t size, size_t num_slots) {
+	slot_size = size;
+	slots.resize(num_slots);
+	for (size_t i = 0; i < num_slots; ++i) {
+		slots[i].offset = i * slot_size;
+		slots[i].fence = 0;
+	}
+	current = num_slots - 1;
+	const GLsizeiptr total = slot_size * num_slots;
+
+	glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	BufferStorageFn buffer_storage = nullptr;
+	if (SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) {
+		buffer_storage = reinterpret_cast<BufferStorageFn>(SDL_GL_GetProcAddress("glBufferStorage"));
+	}
+	if (buffer_storage) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		buffer_storage(GL_PIXEL_UNPACK_BUFFER, total, nullptr, flags);
+		persistent_map = static_cast<char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total, flags));
+		if (!persistent_map) {
+			std::cerr << "Failed to persistently map the pixel upload buffer\n";
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return false;
+		}
+	} else {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, total, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	std::cout << "Streaming frames through " << num_slots << " pixel buffers, "
+		<< (persistent_map ? "persistently mapped\n" : "mapped per frame\n");
+	return true;
+}
+void* PboRing::map_next() {
+	current = (current + 1) % slots.size();
+	Slot &slot = slots[current];
+	if (slot.fence) {
+		// Only flush on the first wait, after that the fence is already in the command stream
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		GLenum status = GL_TIMEOUT_EXPIRED;
+		while (status == GL_TIMEOUT_EXPIRED) {
+			status = glClientWaitSync(slot.fence, flags, 1000000);
+			flags = 0;
+		}
+		if (status == GL_WAIT_FAILED) {
+			std::cerr << "Waiting on a pixel buffer fence failed\n";
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+	}
+	if (persistent_map) {
+		return persistent_map + slot.offset;
+	}
+	// The fence guarantees the GPU is done reading the slot so we don't need the
+	// driver to synchronize the mapping
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	void *ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, slot.offset, slot_size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return ptr;
+}
+GLintptr PboRing::bind_for_unpack() {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	if (!persistent_map) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	return slots[current].offset;
+}
+void PboRing::fence() {
+	slots[current].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "gl_core_3_3.h"
+
+/* A ring of pixel unpack buffer slots used to stream the rendered frames to
+ * textures without the driver copying or stalling on client memory. Each frame
+ * the pixels are written into the next slot and the texture uploads are sourced
+ * from it, a fence placed after the uploads tells us when the slot can be reused.
+ * If GL_ARB_buffer_storage is available the buffer is persistently mapped, otherwise
+ * each slot is mapped unsynchronized when it's written, relying on the fences
+ */
+class PboRing {
+	struct Slot {
+		GLintptr offset;
+		GLsync fence;
+	};
+	GLuint pbo;
+	size_t slot_size;
+	std::vector<Slot> slots;
+	size_t current;
+	// Base of the persistent mapping, null if we map the slots each frame
+	char *persistent_map;
+
+public:
+	PboRing();
+	~PboRing();
+	PboRing(const PboRing&) = delete;
+	PboRing& operator=(const PboRing&) = delete;
+
+	// Create the buffer with num_slots slots of slot_size bytes each
+	bool init(size_t slot_size, size_t num_slots);
+	/* Wait for the next slot to be free and return a pointer to write
+	 * slot_size bytes of pixels to
+	 */
+	void* map_next();
+	/* Finish writing the slot and bind it as the GL_PIXEL_UNPACK_BUFFER,
+	 * the returned offset of the slot should be added to the offsets of the
+	 * texture uploads sourced from it
+	 */
+	GLintptr bind_for_unpack();
+	// Fence the uploads issued from the slot and unbind the buffer
+	void fence();
+};
+
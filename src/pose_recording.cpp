@@ -0,0 +1,95 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include "pose_recording.h"
+
+bool read_pose_recording(const std::string &file, PoseRecording &recording) {
+	std::ifstream fin(file.c_str());
+	if (!fin) {
+		std::cerr << "Failed to open pose recording " << file << "\n";
+		return false;
+	}
+	bool have_dims = false;
+	std::array<bool, 2> have_eye = {false, false};
+	recording.poses.clear();
+
+	std::string line;
+	size_t line_num = 0;
+	while (std::getline(fin, line)) {
+		++line_num;
+		std::istringstream ss(line);
+		std::string cmd;
+		if (!(ss >> cmd) || cmd[0] == '#') {
+			continue;
+		}
+		bool ok = false;
+		if (cmd == "render_dims") {
+			ok = static_cast<bool>(ss >> recording.render_dims[0] >> recording.render_dims[1]);
+			have_dims = ok;
+		} else if (cmd == "eye") {
+			size_t i = 0;
+			EyeParams eye;
+			ok = ss >> i >> eye.left >> eye.right >> eye.top >> eye.bottom
+				>> eye.offset.x >> eye.offset.y >> eye.offset.z && i < 2;
+			if (ok) {
+				recording.eyes[i] = eye;
+				have_eye[i] = true;
+			}
+		} else if (cmd == "pose") {
+			std::array<float, 12> m;
+			ok = true;
+			for (auto &x : m) {
+				ok = ok && ss >> x;
+			}
+			if (ok) {
+				recording.poses.push_back(ospcommon::AffineSpace3f(
+							ospcommon::vec3f(m[0], m[4], m[8]),
+							ospcommon::vec3f(m[1], m[5], m[9]),
+							ospcommon::vec3f(m[2], m[6], m[10]),
+							ospcommon::vec3f(m[3], m[7], m[11])));
+			}
+		}
+		if (!ok) {
+			std::cerr << "Invalid line " << line_num << " in pose recording " << file
+				<< ": " << line << "\n";
+			return false;
+		}
+	}
+	if (!have_dims || !have_eye[0] || !have_eye[1] || recording.poses.empty()) {
+		std::cerr << "Pose recording " << file
+			<< " must have the render_dims, both eyes and at least one pose\n";
+		return false;
+	}
+	return true;
+}
+
+bool PoseRecorder::open(const std::string &file, const std::array<uint32_t, 2> &render_dims,
+		const std::array<EyeParams, 2> &eyes)
+{
+	fout.open(file.c_str());
+	if (!fout) {
+		std::cerr << "Failed to open pose recording " << file << " for writing\n";
+		return false;
+	}
+	fout << "# ospray-vive pose recording\n"
+		<< std::setprecision(9)
+		<< "render_dims " << render_dims[0] << " " << render_dims[1] << "\n";
+	for (size_t i = 0; i < eyes.size(); ++i) {
+		const EyeParams &e = eyes[i];
+		fout << "eye " << i << " " << e.left << " " << e.right << " " << e.top << " " << e.bottom
+			<< " " << e.offset.x << " " << e.offset.y << " " << e.offset.z << "\n";
+	}
+	return true;
+}
+void PoseRecorder::record(const ospcommon::AffineSpace3f &pose) {
+	fout << "pose";
+	for (size_t r = 0; r < 3; ++r) {
+		fout << " " << pose.l.vx[r] << " " << pose.l.vy[r] << " " << pose.l.vz[r]
+			<< " " << pose.p[r];
+	}
+	fout << "\n";
+}
+bool PoseRecorder::is_open() const {
+	return fout.is_open();
+}
+
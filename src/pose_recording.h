@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "vr_backend.h"
+
+/* A pose recording is a text file with the HMD's per eye render size, view
+ * parameters and the head pose of each frame, one statement per line:
+ *
+ *   render_dims <width> <height>
+ *   eye <0|1> <left> <right> <top> <bottom> <offset x> <offset y> <offset z>
+ *   pose <3x4 row major head to tracking space matrix, as in OpenVR>
+ *
+ * Lines starting with # are comments.
+ */
+struct PoseRecording {
+	std::array<uint32_t, 2> render_dims;
+	std::array<EyeParams, 2> eyes;
+	std::vector<ospcommon::AffineSpace3f> poses;
+};
+
+// Read a pose recording, returns false and prints the problem if it's invalid
+bool read_pose_recording(const std::string &file, PoseRecording &recording);
+
+// Writes the poses of a session to a recording as they're rendered
+class PoseRecorder {
+	std::ofstream fout;
+
+public:
+	bool open(const std::string &file, const std::array<uint32_t, 2> &render_dims,
+			const std::array<EyeParams, 2> &eyes);
+	void record(const ospcommon::AffineSpace3f &pose);
+	bool is_open() const;
+};
+
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "profiler.h"
+#include "json_util.h"
+
+// The GPU's row in the trace, the CPU threads are numbered from 1
+static const uint32_t GPU_TID = 0;
+
+struct TraceEvent {
+	const char *name;
+	int64_t start_ns;
+	int64_t end_ns;
+	uint32_t tid;
+};
+
+static std::atomic<bool> enabled(false);
+static std::atomic<uint32_t> next_tid(GPU_TID + 1);
+static thread_local uint32_t thread_tid = 0;
+static std::mutex events_mutex;
+static std::vector<TraceEvent> events;
+static std::map<uint32_t, std::string> thread_names;
+
+static uint32_t current_tid() {
+	if (thread_tid == 0) {
+		thread_tid = next_tid++;
+	}
+	return thread_tid;
+}
+static void record_event(const char *name, int64_t start_ns, int64_t end_ns, uint32_t tid) {
+	std::lock_guard<std::mutex> lock(events_mutex);
+	events.push_back(TraceEvent{name, start_ns, end_ns, tid});
+}
+
+void profiler_enable() {
+	{
+		std::lock_guard<std::mutex> lock(events_mutex);
+		// Reserve enough for a couple of minutes of frames up front so recording rarely reallocates
+		events.reserve(1 << 18);
+		thread_names[GPU_TID] = "GPU";
+	}
+	enabled = true;
+}
+bool profiler_enabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+void profiler_set_thread_name(const std::string &name) {
+	const uint32_t tid = current_tid();
+	std::lock_guard<std::mutex> lock(events_mutex);
+	thread_names[tid] = name;
+}
+void profiler_record(const char *name, int64_t start_ns, int64_t end_ns) {
+	record_event(name, start_ns, end_ns, current_tid());
+}
+void profiler_record_gpu(const char *name, int64_t start_ns, int64_t end_ns) {
+	record_event(name, start_ns, end_ns, GPU_TID);
+}
+bool profiler_write(const std::string &file) {
+	std::lock_guard<std::mutex> lock(events_mutex);
+	std::ofstream fout(file.c_str());
+	if (!fout) {
+		std::cerr << "Failed to open trace output " << file << "\n";
+		return false;
+	}
+	// The trace is in microseconds, start it at the first event
+	int64_t origin = std::numeric_limits<int64_t>::max();
+	for (const auto &e : events) {
+		origin = std::min(origin, e.start_ns);
+	}
+	fout << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+	bool first = true;
+	for (const auto &t : thread_names) {
+		fout << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+			<< t.first << ", \"args\": {\"name\": \"" << json_escape(t.second) << "\"}}";
+		first = false;
+	}
+	for (const auto &e : events) {
+		fout << (first ? "" : ",\n") << "{\"name\": \"" << json_escape(e.name) << "\", \"cat\": \""
+			<< (e.tid == GPU_TID ? "gpu" : "cpu") << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.tid
+			<< ", \"ts\": " << (e.start_ns - origin) / 1000.0 << ", \"dur\": " << (e.end_ns - e.start_ns) / 1000.0
+			<< "}";
+		first = false;
+	}
+	fout << "\n]}\n";
+	if (!fout) {
+		std::cerr << "Failed to write trace output " << file << "\n";
+		return false;
+	}
+	std::cout << "Trace of " << events.size() << " events written to " << file << "\n";
+	return true;
+}
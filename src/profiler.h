@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/* A low overhead profiler of the scopes of each frame, written out as a Chrome
+ * trace (chrome://tracing or ui.perfetto.dev) to see where the frame time goes.
+ * Events are only recorded after profiler_enable, otherwise a scope costs one
+ * relaxed atomic load. The events are on the steady clock in nanoseconds and can
+ * be recorded from any thread, each thread is shown as its own row. The GPU's
+ * events are recorded by the GpuProfiler, see gpu_profiler.h
+ */
+void profiler_enable();
+bool profiler_enabled();
+// Name the calling thread's row in the trace
+void profiler_set_thread_name(const std::string &name);
+// Record an event on the calling thread's row, the name must be a string literal
+void profiler_record(const char *name, int64_t start_ns, int64_t end_ns);
+// Record an event on the GPU's row, the name must be a string literal
+void profiler_record_gpu(const char *name, int64_t start_ns, int64_t end_ns);
+// Write the events recorded so far as a Chrome trace event JSON file
+bool profiler_write(const std::string &file);
+
+inline int64_t steady_ns(const std::chrono::steady_clock::time_point &t) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+inline int64_t steady_now_ns() {
+	return steady_ns(std::chrono::steady_clock::now());
+}
+
+// Records the time from its creation to its destruction as an event
+class ProfileScope {
+	const char *name;
+	int64_t start_ns;
+
+public:
+	explicit ProfileScope(const char *name)
+		: name(name), start_ns(profiler_enabled() ? steady_now_ns() : 0)
+	{}
+	~ProfileScope() {
+		if (start_ns != 0) {
+			profiler_record(name, start_ns, steady_now_ns());
+		}
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
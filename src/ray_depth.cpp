@@ -0,0 +1,73 @@
+#include "ray_depth.h"
+#include "gl_util.h"
+
+/* The camera's rays are normalized, so the distance t along the ray through the
+ * image plane point (x, y, -1) is at view space depth t / |(x, y, 1)|. Rays which
+ * missed or were never traced are infinitely far and go to the far plane
+ */
+static const char *DEPTH_FRAG_SRC = R"(
+#version 330 core
+uniform sampler2D ray_depth;
+uniform vec2 uv_scale;
+uniform vec2 tan_lo;
+uniform vec2 tan_hi;
+uniform vec2 depth_proj;
+in vec2 uv;
+
+void main(void) {
+	float t = texture(ray_depth, uv * uv_scale).r;
+	vec2 tan_dir = mix(tan_lo, tan_hi, uv);
+	float z = t / sqrt(1.0 + dot(tan_dir, tan_dir));
+	if (isinf(t) || isnan(t) || z <= 0.0) {
+		gl_FragDepth = 1.0;
+	} else {
+		gl_FragDepth = clamp((depth_proj.x * -z + depth_proj.y) / z, 0.0, 1.0);
+	}
+}
+)";
+
+RayDepthResolve::RayDepthResolve() : program(0), vao(0) {}
+RayDepthResolve::~RayDepthResolve() {
+	if (program) {
+		glDeleteProgram(program);
+	}
+	if (vao) {
+		glDeleteVertexArrays(1, &vao);
+	}
+}
+bool RayDepthResolve::init() {
+	program = load_program(FULLSCREEN_VERT_SRC, DEPTH_FRAG_SRC, "ray depth");
+	if (!program) {
+		return false;
+	}
+	ray_depth_unif = glGetUniformLocation(program, "ray_depth");
+	uv_scale_unif = glGetUniformLocation(program, "uv_scale");
+	tan_lo_unif = glGetUniformLocation(program, "tan_lo");
+	tan_hi_unif = glGetUniformLocation(program, "tan_hi");
+	depth_proj_unif = glGetUniformLocation(program, "depth_proj");
+	glGenVertexArrays(1, &vao);
+	return true;
+}
+void RayDepthResolve::draw(GLuint texture, const EyeParams &eye, const std::array<float, 2> &depth_proj,
+		const std::array<uint32_t, 2> &image_dims, const std::array<uint32_t, 2> &tex_dims)
+{
+	glUseProgram(program);
+	glBindVertexArray(vao);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glUniform1i(ray_depth_unif, 0);
+	glUniform2f(uv_scale_unif, static_cast<float>(image_dims[0]) / tex_dims[0],
+			static_cast<float>(image_dims[1]) / tex_dims[1]);
+	// The same image plane the camera traces, see main.cpp
+	glUniform2f(tan_lo_unif, eye.left, eye.top);
+	glUniform2f(tan_hi_unif, eye.right, eye.bottom);
+	glUniform2f(depth_proj_unif, depth_proj[0], depth_proj[1]);
+	// Every fragment is written, so depth test always passes and we don't clear
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
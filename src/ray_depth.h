@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "gl_core_3_3.h"
+#include "vr_backend.h"
+
+/* Converts the distances along the rays OSPRay writes to its depth channel
+ * to the depth buffer values of an eye's projection, so the compositor can
+ * use them to reproject the frame
+ */
+class RayDepthResolve {
+	GLuint program;
+	GLuint vao;
+	GLint ray_depth_unif, uv_scale_unif, tan_lo_unif, tan_hi_unif, depth_proj_unif;
+
+public:
+	RayDepthResolve();
+	~RayDepthResolve();
+	RayDepthResolve(const RayDepthResolve&) = delete;
+	RayDepthResolve& operator=(const RayDepthResolve&) = delete;
+
+	bool init();
+	/* Draw the depth of the eye to the depth attachment of the bound draw framebuffer,
+	 * filling its viewport. The ray distances are the lower left image_dims of the float
+	 * texture, which is tex_dims in size. The depth is projected with the third row of
+	 * the eye's projection matrix, which maps the view space z to the depth in [0, 1]
+	 */
+	void draw(GLuint texture, const EyeParams &eye, const std::array<float, 2> &depth_proj,
+			const std::array<uint32_t, 2> &image_dims, const std::array<uint32_t, 2> &tex_dims);
+};
+
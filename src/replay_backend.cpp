@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "replay_backend.h"
+
+ReplayBackend::ReplayBackend() : next_pose(0), frame(0), loop(false) {}
+bool ReplayBackend::open(const std::string &recording_file, const std::string &dump, bool loop_poses) {
+	if (!read_pose_recording(recording_file, recording)) {
+		return false;
+	}
+	next_pose = 0;
+	frame = 0;
+	dump_dir = dump;
+	loop = loop_poses;
+	std::cout << "Replaying " << recording.poses.size() << " poses from " << recording_file
+		<< " at " << recording.render_dims[0] << "x" << recording.render_dims[1] << " per eye\n";
+	return true;
+}
+std::array<uint32_t, 2> ReplayBackend::render_dims() const {
+	return recording.render_dims;
+}
+EyeParams ReplayBackend::eye_params(size_t eye) const {
+	return recording.eyes[eye];
+}
+bool ReplayBackend::apply_lens_distortion(const std::array<uint32_t, 2>&,
+		std::vector<ospcommon::vec2f>&)
+{
+	// The recordings don't have the lens distortion
+	return false;
+}
+bool ReplayBackend::hidden_area_mesh(size_t, std::vector<ospcommon::vec2f>&) const {
+	return false;
+}
+bool ReplayBackend::poll_events() {
+	return true;
+}
+bool ReplayBackend::wait_get_pose(ospcommon::AffineSpace3f &hmd_pose) {
+	if (next_pose >= recording.poses.size()) {
+		if (!loop) {
+			return false;
+		}
+		next_pose = 0;
+	}
+	hmd_pose = recording.poses[next_pose++];
+	return true;
+}
+bool ReplayBackend::predicted_vsync(std::chrono::steady_clock::time_point&) const {
+	return false;
+}
+bool ReplayBackend::wants_depth() const {
+	return false;
+}
+void ReplayBackend::submit(const uint32_t *image, const float*, const std::array<uint32_t, 2> &eye_dims,
+		const ospcommon::AffineSpace3f&, FrameTimes &times)
+{
+	const size_t f = frame++;
+	if (dump_dir.empty()) {
+		return;
+	}
+	StageTimer timer;
+	// Write the frame as a binary PPM, flipping it so the first row is the top
+	const size_t width = eye_dims[0] * 2;
+	const size_t height = eye_dims[1];
+	dump_buf.resize(width * height * 3);
+	for (size_t y = 0; y < height; ++y) {
+		const uint8_t *row = reinterpret_cast<const uint8_t*>(image + (height - y - 1) * width);
+		uint8_t *out = &dump_buf[y * width * 3];
+		for (size_t x = 0; x < width; ++x) {
+			out[x * 3] = row[x * 4];
+			out[x * 3 + 1] = row[x * 4 + 1];
+			out[x * 3 + 2] = row[x * 4 + 2];
+		}
+	}
+	char name[32];
+	std::snprintf(name, sizeof(name), "frame_%05zu.ppm", f);
+	const std::string file = dump_dir + "/" + name;
+	std::ofstream fout(file.c_str(), std::ios::binary);
+	fout << "P6\n" << width << " " << height << "\n255\n";
+	fout.write(reinterpret_cast<const char*>(dump_buf.data()), dump_buf.size());
+	if (!fout) {
+		std::cerr << "Failed to write frame " << file << "\n";
+	}
+	times.stage_ms[STAGE_SUBMIT] = timer.lap();
+}
+void ReplayBackend::show_status(const std::string &) {}
+
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include "pose_recording.h"
+#include "vr_backend.h"
+
+/* Replays a pose recording without an HMD or GPU, the frames are
+ * rendered as fast as possible into OSPRay's framebuffer and can
+ * optionally be written to disk as PPM images
+ */
+class ReplayBackend : public VrBackend {
+	PoseRecording recording;
+	size_t next_pose;
+	size_t frame;
+	bool loop;
+	std::string dump_dir;
+	std::vector<uint8_t> dump_buf;
+
+public:
+	ReplayBackend();
+	/* Load the recording to replay, if dump_dir isn't empty each frame
+	 * is written to <dump_dir>/frame_<n>.ppm. If loop is set the poses
+	 * are repeated from the start after the last one
+	 */
+	bool open(const std::string &recording_file, const std::string &dump_dir, bool loop);
+
+	std::array<uint32_t, 2> render_dims() const override;
+	EyeParams eye_params(size_t eye) const override;
+	bool apply_lens_distortion(const std::array<uint32_t, 2> &grid_dims,
+			std::vector<ospcommon::vec2f> &grid) override;
+	bool hidden_area_mesh(size_t eye, std::vector<ospcommon::vec2f> &triangles) const override;
+	bool poll_events() override;
+	bool wait_get_pose(ospcommon::AffineSpace3f &hmd_pose) override;
+	bool predicted_vsync(std::chrono::steady_clock::time_point &vsync) const override;
+	bool wants_depth() const override;
+	void submit(const uint32_t *image, const float *depth, const std::array<uint32_t, 2> &eye_dims,
+			const ospcommon::AffineSpace3f &hmd_pose, FrameTimes &times) override;
+	void show_status(const std::string &status) override;
+};
+
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cmath>
+#include "resolution_controller.h"
+
+// Weight of the latest frame in the smoothed render time
+static const double SMOOTHING = 0.2;
+// Stay under this fraction of the budget when picking the new resolution
+static const double HEADROOM = 0.9;
+// Only grow the resolution when under this fraction of the budget
+static const double GROW_THRESHOLD = 0.75;
+// Frames over or under the thresholds before changing the resolution,
+// we drop quickly to avoid missing frames but grow back slowly
+static const size_t SHRINK_FRAMES = 3;
+static const size_t GROW_FRAMES = 45;
+// Limit each step so a single slow frame can't tank the resolution
+static const float MIN_STEP = 0.7f;
+static const float MAX_STEP = 1.1f;
+// Keep the dimensions a multiple of this so the steps aren't tiny
+static const uint32_t DIM_ALIGN = 8;
+
+ResolutionController::ResolutionController(const std::array<uint32_t, 2> &max_dims, double target_ms,
+		float min_scale)
+	: max_dims(max_dims), target_ms(target_ms), min_scale(min_scale), scale(1.f), avg_ms(-1.0),
+	frames_over(0), frames_under(0)
+{}
+bool ResolutionController::update(double render_ms) {
+	avg_ms = avg_ms < 0.0 ? render_ms : avg_ms + SMOOTHING * (render_ms - avg_ms);
+	if (avg_ms > target_ms) {
+		++frames_over;
+		frames_under = 0;
+	} else if (avg_ms < target_ms * GROW_THRESHOLD) {
+		++frames_under;
+		frames_over = 0;
+	} else {
+		frames_over = 0;
+		frames_under = 0;
+	}
+	if (frames_over < SHRINK_FRAMES && frames_under < GROW_FRAMES) {
+		return false;
+	}
+	frames_over = 0;
+	frames_under = 0;
+
+	const std::array<uint32_t, 2> prev_dims = dims();
+	const float step = static_cast<float>(std::sqrt(target_ms * HEADROOM / avg_ms));
+	const float new_scale = std::min(std::max(scale * std::min(std::max(step, MIN_STEP), MAX_STEP),
+				min_scale), 1.f);
+	// Expect the time to change with the number of pixels until we've measured the new resolution
+	avg_ms *= (new_scale * new_scale) / (scale * scale);
+	scale = new_scale;
+	return dims() != prev_dims;
+}
+std::array<uint32_t, 2> ResolutionController::dims() const {
+	std::array<uint32_t, 2> d;
+	for (size_t i = 0; i < d.size(); ++i) {
+		const uint32_t aligned = static_cast<uint32_t>(std::round(max_dims[i] * scale / DIM_ALIGN)) * DIM_ALIGN;
+		d[i] = std::min(std::max(aligned, DIM_ALIGN), max_dims[i]);
+	}
+	return d;
+}
+float ResolutionController::current_scale() const {
+	return scale;
+}
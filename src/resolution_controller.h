@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/* Scales the per eye render resolution to keep the render time within a budget.
+ * The render time is smoothed over a few frames and the resolution drops quickly
+ * once it's over the budget, but only grows back after it has stayed well under the
+ * budget for a while, so it doesn't oscillate around the budget. The render time
+ * is assumed to scale with the number of pixels to pick the new resolution.
+ */
+class ResolutionController {
+	std::array<uint32_t, 2> max_dims;
+	double target_ms;
+	float min_scale;
+	float scale;
+	double avg_ms;
+	size_t frames_over, frames_under;
+
+public:
+	/* Scale the resolution between min_scale and 1 of max_dims to keep the
+	 * render time under target_ms
+	 */
+	ResolutionController(const std::array<uint32_t, 2> &max_dims, double target_ms,
+			float min_scale = 0.5f);
+	// Update with a frame's render time, returns true if the resolution changed
+	bool update(double render_ms);
+	// The per eye resolution to render at
+	std::array<uint32_t, 2> dims() const;
+	float current_scale() const;
+};
+
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <iostream>
+#include "scene_loader.h"
+
+SceneLoader::SceneLoader(const std::string &model_file)
+	: model_file(model_file), next_ready(0), done(false), failed(false), cancelled(false)
+{
+	thread = std::thread([this](){ load(); });
+}
+SceneLoader::~SceneLoader() {
+	cancelled = true;
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+bool SceneLoader::take_meshes(std::vector<LoadedMesh> &meshes, size_t max_triangles) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (next_ready == ready.size()) {
+		return false;
+	}
+	size_t num_triangles = 0;
+	while (next_ready < ready.size()
+			&& (num_triangles == 0 || num_triangles + ready[next_ready].num_triangles <= max_triangles))
+	{
+		num_triangles += ready[next_ready].num_triangles;
+		meshes.push_back(ready[next_ready++]);
+	}
+	return true;
+}
+bool SceneLoader::finished() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return done && next_ready == ready.size();
+}
+void SceneLoader::release_previews() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (done && next_ready == ready.size()) {
+		std::deque<ParsedMesh>().swap(parsed);
+	}
+}
+bool SceneLoader::load_failed() const {
+	return failed;
+}
+void SceneLoader::load() {
+	// Load the model from the binary mesh cache if there's an up to date one,
+	// otherwise load it w/ tinyobjloader and write the cache for next time
+	if (mesh_cache.open(model_file)) {
+		std::cout << "Loading model from mesh cache " << mesh_cache_file(model_file) << "\n";
+		publish_cache();
+		done = true;
+		return;
+	}
+
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::material_t> materials;
+	std::string err;
+	// We only use the positions, so just load the packed int3 vertex indices.
+	// The faces are only kept in the pieces published from parsed_chunk, so
+	// tinyobj doesn't build the shapes
+	bool ret = tinyobj::LoadObjParallel(&attrib, nullptr, &materials, &err, model_file.c_str(),
+			nullptr, true, 0, true, &SceneLoader::parsed_chunk, this);
+	std::vector<int32_t>().swap(vertex_remap);
+	if (cancelled) {
+		done = true;
+		return;
+	}
+	if (!err.empty()) {
+		std::cerr << "Error loading model: " << err << "\n";
+	}
+	if (!ret) {
+		failed = true;
+		done = true;
+		return;
+	}
+	publish_shapes(attrib);
+	done = true;
+}
+bool SceneLoader::parsed_chunk(void *user_data, const tinyobj::attrib_t &attrib,
+		const std::vector<tinyobj::shape_t> &pieces, const std::vector<size_t> &piece_shapes)
+{
+	SceneLoader *loader = static_cast<SceneLoader*>(user_data);
+	if (loader->cancelled) {
+		return false;
+	}
+	for (size_t i = 0; i < pieces.size(); ++i) {
+		loader->publish_piece(piece_shapes[i], pieces[i].name, attrib, pieces[i].mesh.vertex_indices);
+	}
+	return !loader->cancelled;
+}
+void SceneLoader::publish_piece(size_t shape, const std::string &name,
+		const tinyobj::attrib_t &attrib, const std::vector<int32_t> &indices)
+{
+	// Copy the vertices the piece uses in the order they're first referenced, the
+	// triangles with vertices not loaded yet are deferred to the merged shape
+	const int32_t num_vertices = static_cast<int32_t>(attrib.vertices.size() / 3);
+	vertex_remap.resize(num_vertices, -1);
+	ParsedMesh mesh;
+	mesh.shape = shape;
+	mesh.name = name;
+	ParsedMesh missing;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const int32_t *tri = &indices[i];
+		if (tri[0] < 0 || tri[0] >= num_vertices || tri[1] < 0 || tri[1] >= num_vertices
+				|| tri[2] < 0 || tri[2] >= num_vertices)
+		{
+			missing.indices.insert(missing.indices.end(), tri, tri + 3);
+			continue;
+		}
+		for (size_t j = 0; j < 3; ++j) {
+			int32_t &remapped = vertex_remap[tri[j]];
+			if (remapped < 0) {
+				remapped = static_cast<int32_t>(mesh.vertex_ids.size());
+				mesh.vertex_ids.push_back(tri[j]);
+				const float *v = &attrib.vertices[3 * tri[j]];
+				mesh.positions.insert(mesh.positions.end(), v, v + 3);
+			}
+			mesh.indices.push_back(remapped);
+		}
+	}
+	for (const int32_t v : mesh.vertex_ids) {
+		vertex_remap[v] = -1;
+	}
+	if (!missing.indices.empty()) {
+		missing.shape = shape;
+		missing.name = name;
+		deferred.push_back(std::move(missing));
+	}
+	if (mesh.indices.empty()) {
+		return;
+	}
+
+	parsed.push_back(std::move(mesh));
+	const ParsedMesh &p = parsed.back();
+	LoadedMesh loaded;
+	loaded.name = name;
+	loaded.positions = p.positions.data();
+	loaded.num_vertices = p.positions.size() / 3;
+	loaded.indices = p.indices.data();
+	loaded.num_triangles = p.indices.size() / 3;
+	loaded.preview = true;
+	publish(std::vector<LoadedMesh>{loaded});
+}
+void SceneLoader::publish_shapes(tinyobj::attrib_t &attrib) {
+	// Gather the pieces of each shape, the deferred triangles still referencing
+	// vertices past the end of the file are invalid and dropped
+	std::vector<float>().swap(attrib.normals);
+	std::vector<float>().swap(attrib.texcoords);
+	const size_t num_vertices = attrib.vertices.size() / 3;
+	std::vector<MeshCacheSource> shapes;
+	std::vector<size_t> shape_ids;
+	auto add_piece = [&](const ParsedMesh &p, const int32_t *vertex_ids) {
+		const size_t s = std::lower_bound(shape_ids.begin(), shape_ids.end(), p.shape)
+			- shape_ids.begin();
+		if (s == shape_ids.size() || shape_ids[s] != p.shape) {
+			shape_ids.insert(shape_ids.begin() + s, p.shape);
+			MeshCacheSource shape;
+			shape.name = p.name;
+			shapes.insert(shapes.begin() + s, shape);
+		}
+		MeshCachePiece piece;
+		piece.indices = p.indices.data();
+		piece.num_triangles = p.indices.size() / 3;
+		piece.vertex_ids = vertex_ids;
+		shapes[s].pieces.push_back(piece);
+	};
+	for (const auto &p : parsed) {
+		add_piece(p, p.vertex_ids.data());
+	}
+	for (auto &d : deferred) {
+		auto valid = [&](const int32_t *tri) {
+			for (size_t j = 0; j < 3; ++j) {
+				if (tri[j] < 0 || static_cast<size_t>(tri[j]) >= num_vertices) {
+					return false;
+				}
+			}
+			return true;
+		};
+		size_t n = 0;
+		for (size_t i = 0; i + 2 < d.indices.size(); i += 3) {
+			if (valid(&d.indices[i])) {
+				std::copy(&d.indices[i], &d.indices[i] + 3, &d.indices[n]);
+				n += 3;
+			}
+		}
+		d.indices.resize(n);
+		if (n != 0) {
+			add_piece(d, nullptr);
+		}
+	}
+
+	// Write the cache from the pieces and publish the shapes from its mapping,
+	// so the parser's vertices can be freed. If the cache can't be written the
+	// shapes are merged in memory instead
+	if (write_mesh_cache(model_file, attrib.vertices.data(), num_vertices, shapes)
+			&& mesh_cache.open(model_file))
+	{
+		std::vector<float>().swap(attrib.vertices);
+		publish_cache();
+	} else {
+		std::cout << "Failed to write mesh cache " << mesh_cache_file(model_file) << "\n";
+		merged_positions.swap(attrib.vertices);
+		std::vector<LoadedMesh> meshes;
+		for (const auto &s : shapes) {
+			std::vector<int32_t> indices;
+			for (const auto &p : s.pieces) {
+				for (size_t i = 0; i < p.num_triangles * 3; ++i) {
+					indices.push_back(p.vertex_ids ? p.vertex_ids[p.indices[i]] : p.indices[i]);
+				}
+			}
+			merged_indices.push_back(std::move(indices));
+			LoadedMesh mesh;
+			mesh.name = s.name;
+			mesh.positions = merged_positions.data();
+			mesh.num_vertices = num_vertices;
+			mesh.indices = merged_indices.back().data();
+			mesh.num_triangles = merged_indices.back().size() / 3;
+			mesh.preview = false;
+			meshes.push_back(mesh);
+		}
+		publish(meshes);
+	}
+	std::deque<ParsedMesh>().swap(deferred);
+}
+void SceneLoader::publish_cache() {
+	std::vector<LoadedMesh> meshes;
+	for (const auto &s : mesh_cache.shapes) {
+		LoadedMesh mesh;
+		mesh.name = s.name;
+		mesh.positions = mesh_cache.positions;
+		mesh.num_vertices = mesh_cache.num_vertices;
+		mesh.indices = s.indices;
+		mesh.num_triangles = s.num_triangles;
+		mesh.preview = false;
+		meshes.push_back(mesh);
+	}
+	publish(meshes);
+}
+void SceneLoader::publish(const std::vector<LoadedMesh> &meshes) {
+	std::lock_guard<std::mutex> lock(mutex);
+	ready.insert(ready.end(), meshes.begin(), meshes.end());
+}
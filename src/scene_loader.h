@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mesh_cache.h"
+#include "tiny_obj_loader.h"
+
+// A mesh ready to be added to the scene, the arrays are owned by the loader
+struct LoadedMesh {
+	std::string name;
+	const float *positions;
+	size_t num_vertices;
+	const int32_t *indices;
+	size_t num_triangles;
+	// The mesh is a piece of a shape shown while the OBJ is parsed, it should be
+	// removed from the scene once loading finishes and the merged shapes are added
+	bool preview;
+};
+
+/* Loads the model on a background thread so the app can start rendering and
+ * submitting poses right away. The loader only builds the CPU side arrays,
+ * the render thread takes the finished meshes between frames and creates the
+ * OSPRay objects for them itself. The positions and indices of the meshes
+ * are owned by the loader and stay valid until it's destroyed, so they can
+ * be shared with OSPRay without a copy.
+ *
+ * When parsing an OBJ the pieces of the shapes in each chunk are published
+ * as preview meshes as the chunk is merged, so a large model fills in while
+ * it's parsed. The parser's vertex array is still growing then, so each piece
+ * gets its own copy of just the vertices it uses. The pieces are the only copy
+ * of the faces, once the parse is done the mesh cache is written from them,
+ * the parser's vertices are freed and one mesh per shape is published from the
+ * mapped cache. The render thread then swaps out the previews and calls
+ * release_previews to free them.
+ */
+class SceneLoader {
+	// A piece of a shape published while parsing, vertex_ids maps its vertices
+	// back to the model's for merging the shape
+	struct ParsedMesh {
+		size_t shape;
+		std::string name;
+		std::vector<float> positions;
+		std::vector<int32_t> indices;
+		std::vector<int32_t> vertex_ids;
+	};
+
+	std::string model_file;
+	MeshCache mesh_cache;
+	std::deque<ParsedMesh> parsed;
+	// Maps the parser's vertex indices to the piece being copied, -1 if unused
+	std::vector<int32_t> vertex_remap;
+	// Triangles referencing vertices further on in the file than their chunk,
+	// with the model's vertex indices. They're added to their shape once the
+	// parse is done
+	std::deque<ParsedMesh> deferred;
+	// The merged shapes if the mesh cache couldn't be written
+	std::vector<float> merged_positions;
+	std::deque<std::vector<int32_t>> merged_indices;
+
+	std::mutex mutex;
+	std::vector<LoadedMesh> ready;
+	size_t next_ready;
+	std::atomic<bool> done;
+	std::atomic<bool> failed;
+	std::atomic<bool> cancelled;
+	std::thread thread;
+
+	void load();
+	static bool parsed_chunk(void *loader, const tinyobj::attrib_t &attrib,
+			const std::vector<tinyobj::shape_t> &pieces, const std::vector<size_t> &piece_shapes);
+	void publish_piece(size_t shape, const std::string &name, const tinyobj::attrib_t &attrib,
+			const std::vector<int32_t> &indices);
+	// Publish the merged shapes once the parse is done
+	void publish_shapes(tinyobj::attrib_t &attrib);
+	void publish_cache();
+	void publish(const std::vector<LoadedMesh> &meshes);
+
+public:
+	SceneLoader(const std::string &model_file);
+	// Cancels the parse after the chunk being merged instead of waiting for the whole file
+	~SceneLoader();
+	SceneLoader(const SceneLoader&) = delete;
+	SceneLoader& operator=(const SceneLoader&) = delete;
+
+	/* Take up to max_triangles worth of the meshes finished since the last call
+	 * (at least one if any are ready), returns false if none are ready yet
+	 */
+	bool take_meshes(std::vector<LoadedMesh> &meshes, size_t max_triangles);
+	// Check if all meshes have been loaded and taken
+	bool finished();
+	/* Free the preview meshes once loading has finished, they must have been
+	 * removed from the scene and the model recommitted
+	 */
+	void release_previews();
+	bool load_failed() const;
+};
+
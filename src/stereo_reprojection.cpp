@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "ospray/hidden_area_mask.h"
+#include "profiler.h"
+#include "stereo_reprojection.h"
+
+// Relative difference in depth between neighbouring warped samples we treat as an edge
+static const float DEPTH_EDGE_TOLERANCE = 0.05f;
+
+// Check if two neighbouring ray distances are on different sides of a depth edge
+static bool depth_edge(const float a, const float b) {
+	if (std::isinf(a) || std::isinf(b)) {
+		return std::isinf(a) != std::isinf(b);
+	}
+	return std::abs(a - b) > DEPTH_EDGE_TOLERANCE * std::min(a, b);
+}
+
+StereoReprojection::StereoReprojection(const std::array<EyeParams, 2> &eyes,
+		const std::vector<ospcommon::vec2f> &left_hidden_area)
+	: eyes(eyes)
+{
+	if (!left_hidden_area.empty()) {
+		const int dim = ospvr::HIDDEN_MASK_DIM;
+		left_hidden.resize(dim * dim, 0);
+		ospvr::rasterizeHiddenArea(left_hidden_area.data(), left_hidden_area.size(), dim,
+				left_hidden.data());
+	}
+}
+void StereoReprojection::render(OSPFrameBuffer fb, OspObjectState &renderer, OspObjectState &camera,
+		uint32_t channels, float deadline_ms, const std::array<uint32_t, 2> &eye_dims,
+		uint32_t *pixels, float *depth)
+{
+	using namespace std::chrono;
+	const steady_clock::time_point start = steady_clock::now();
+	OSPRenderer osp_renderer = static_cast<OSPRenderer>(renderer.handle());
+	const size_t width = eye_dims[0] * 2;
+	const size_t eye_row = eye_dims[0];
+
+	// Trace the left eye, the right eye's tiles are skipped
+	{
+		ProfileScope scope("ospRenderFrame left");
+		camera.set1i("tracedEyes", 1);
+		camera.commit();
+		renderer.set1f("frameDeadline", 0.f);
+		renderer.commit();
+		ospRenderFrame(fb, osp_renderer, channels);
+	}
+
+	const uint32_t *fb_pixels = static_cast<const uint32_t*>(ospMapFrameBuffer(fb, OSP_FB_COLOR));
+	const float *fb_depth = static_cast<const float*>(ospMapFrameBuffer(fb, OSP_FB_DEPTH));
+	warp(fb_pixels, fb_depth, eye_dims);
+	for (size_t y = 0; y < eye_dims[1]; ++y) {
+		std::memcpy(pixels + y * width, fb_pixels + y * width, eye_row * sizeof(uint32_t));
+		if (depth) {
+			std::memcpy(depth + y * width, fb_depth + y * width, eye_row * sizeof(float));
+		}
+	}
+	ospUnmapFrameBuffer(fb_depth, fb);
+	ospUnmapFrameBuffer(fb_pixels, fb);
+	update_mask(eye_dims);
+
+	// Trace the right eye's pixels we couldn't reuse, tiles of only reused pixels are skipped
+	{
+		ProfileScope scope("ospRenderFrame right");
+		OSPData mask_data = ospNewData(reuse_mask.size(), OSP_UCHAR, reuse_mask.data(), OSP_DATA_SHARED_BUFFER);
+		ospCommit(mask_data);
+		camera.setData("rightReuseMask", mask_data);
+		camera.set2i("reuseMaskSize", eye_dims[0], eye_dims[1]);
+		camera.set1i("tracedEyes", 2);
+		camera.commit();
+		// The left eye's pass has used up some of the time until the deadline
+		float right_deadline_ms = 0.f;
+		if (deadline_ms > 0.f) {
+			const float elapsed_ms = duration<float, std::milli>(steady_clock::now() - start).count();
+			right_deadline_ms = std::max(deadline_ms - elapsed_ms, std::numeric_limits<float>::min());
+		}
+		renderer.set1f("frameDeadline", right_deadline_ms);
+		renderer.commit();
+		ospRenderFrame(fb, osp_renderer, channels);
+		ospRelease(mask_data);
+	}
+
+	ProfileScope compose_scope("stereo_compose");
+	fb_pixels = static_cast<const uint32_t*>(ospMapFrameBuffer(fb, OSP_FB_COLOR));
+	fb_depth = depth ? static_cast<const float*>(ospMapFrameBuffer(fb, OSP_FB_DEPTH)) : nullptr;
+	for (size_t y = 0; y < eye_dims[1]; ++y) {
+		uint32_t *out = pixels + y * width + eye_row;
+		const uint32_t *traced = fb_pixels + y * width + eye_row;
+		const uint8_t *reused = &reuse_mask[y * eye_row];
+		const uint32_t *warped = &warped_color[y * eye_row];
+		for (size_t x = 0; x < eye_row; ++x) {
+			out[x] = reused[x] ? warped[x] : traced[x];
+		}
+		if (depth) {
+			float *out_depth = depth + y * width + eye_row;
+			const float *traced_depth = fb_depth + y * width + eye_row;
+			const float *warped_d = &warped_depth[y * eye_row];
+			for (size_t x = 0; x < eye_row; ++x) {
+				out_depth[x] = reused[x] ? warped_d[x] : traced_depth[x];
+			}
+		}
+	}
+	if (fb_depth) {
+		ospUnmapFrameBuffer(fb_depth, fb);
+	}
+	ospUnmapFrameBuffer(fb_pixels, fb);
+	// Go back to the left eye for the next frame, so the camera doesn't check the
+	// stale mask and the next pose is committed together with it in one commit
+	camera.set1i("tracedEyes", 1);
+}
+void StereoReprojection::warp(const uint32_t *pixels, const float *depth,
+		const std::array<uint32_t, 2> &eye_dims)
+{
+	ProfileScope scope("stereo_warp");
+	const int w = eye_dims[0];
+	const int h = eye_dims[1];
+	const size_t width = w * 2;
+	warped_color.resize(w * h);
+	warped_depth.assign(w * h, -1.f);
+
+	/* Both eyes share the head's orientation, in the camera's space of +x right, +y up
+	 * and +z forward the pixel (u, v) of an eye looks along (x, y, 1) with x, y the
+	 * tangents between its image plane bounds, see main.cpp. A sample at distance t
+	 * along the left eye's ray is at t * normalize(x, y, 1) - offset from the right eye
+	 */
+	const ospcommon::vec3f eye_delta = eyes[1].offset - eyes[0].offset;
+	const float offset[3] = {eye_delta.x, eye_delta.y, -eye_delta.z};
+	const float left_x = eyes[0].left;
+	const float left_y = eyes[0].top;
+	const float step_x = (eyes[0].right - eyes[0].left) / w;
+	const float step_y = (eyes[0].bottom - eyes[0].top) / h;
+	const float right_x = eyes[1].left;
+	const float right_y = eyes[1].top;
+	const float inv_span_x = w / (eyes[1].right - eyes[1].left);
+	const float inv_span_y = h / (eyes[1].bottom - eyes[1].top);
+
+	// The camera gives empty rays to the pixels in hidden cells, and the load balancer
+	// skips the tiles of only hidden cells so those keep stale or uninitialized pixels.
+	// The pixel centers are looked up in the mask like the camera does
+	const int dim = ospvr::HIDDEN_MASK_DIM;
+	std::vector<int> hidden_cell_x;
+	if (!left_hidden.empty()) {
+		hidden_cell_x.resize(w);
+		for (int x = 0; x < w; ++x) {
+			hidden_cell_x[x] = std::min(static_cast<int>((x + 0.5f) / w * dim), dim - 1);
+		}
+	}
+
+	for (int y = 0; y < h; ++y) {
+		const float dy = left_y + (y + 0.5f) * step_y;
+		const uint32_t *row = pixels + y * width;
+		const float *depth_row = depth + y * width;
+		const uint8_t *hidden_row = left_hidden.empty() ? nullptr
+			: &left_hidden[std::min(static_cast<int>((y + 0.5f) / h * dim), dim - 1) * dim];
+		for (int x = 0; x < w; ++x) {
+			if (hidden_row && hidden_row[hidden_cell_x[x]]) {
+				continue;
+			}
+			const float dx = left_x + (x + 0.5f) * step_x;
+			const float t = depth_row[x];
+			// Samples at infinity are seen along the same direction from both eyes
+			float px = dx;
+			float py = dy;
+			float dist = t;
+			if (!std::isinf(t)) {
+				const float scale = t / std::sqrt(dx * dx + dy * dy + 1.f);
+				const float qx = dx * scale - offset[0];
+				const float qy = dy * scale - offset[1];
+				const float qz = scale - offset[2];
+				if (qz <= 0.f) {
+					continue;
+				}
+				px = qx / qz;
+				py = qy / qz;
+				dist = std::sqrt(qx * qx + qy * qy + qz * qz);
+			}
+			const float fx = (px - right_x) * inv_span_x;
+			const float fy = (py - right_y) * inv_span_y;
+			if (!(fx >= 0.f && fx < w && fy >= 0.f && fy < h)) {
+				continue;
+			}
+			// Keep the nearest sample landing on each pixel
+			const size_t i = static_cast<size_t>(fy) * w + static_cast<size_t>(fx);
+			if (warped_depth[i] < 0.f || dist < warped_depth[i]) {
+				warped_depth[i] = dist;
+				warped_color[i] = row[x];
+			}
+		}
+	}
+}
+void StereoReprojection::update_mask(const std::array<uint32_t, 2> &eye_dims) {
+	ProfileScope scope("stereo_mask");
+	const int w = eye_dims[0];
+	const int h = eye_dims[1];
+	reuse_mask.resize(w * h);
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			const size_t i = y * w + x;
+			const float d = warped_depth[i];
+			bool reuse = d >= 0.f;
+			// The pixel and its neighbours must all have samples on the same surface
+			const int nx[4] = {x - 1, x + 1, x, x};
+			const int ny[4] = {y, y, y - 1, y + 1};
+			for (size_t n = 0; n < 4 && reuse; ++n) {
+				if (nx[n] < 0 || nx[n] >= w || ny[n] < 0 || ny[n] >= h) {
+					continue;
+				}
+				const float nd = warped_depth[ny[n] * w + nx[n]];
+				reuse = nd >= 0.f && !depth_edge(d, nd);
+			}
+			reuse_mask[i] = reuse;
+		}
+	}
+}
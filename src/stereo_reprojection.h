@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <ospray/ospray.h>
+#include <ospcommon/vec.h>
+#include "osp_state.h"
+#include "vr_backend.h"
+
+/* Renders the stereo frames by tracing the left eye, forward warping its samples
+ * into the right eye using their depth and only tracing the right eye's pixels
+ * which no left eye sample covers. The warped samples are kept where they agree
+ * with their neighbours, a pixel next to a hole or a depth discontinuity is traced
+ * since it may be disoccluded or show the wrong side of an edge. The left eye's
+ * pixels the camera may not have traced, because they're hidden by the lens, aren't
+ * warped. The reused shading is only correct for view independent shading, like the
+ * raycast renderers'.
+ */
+class StereoReprojection {
+	std::array<EyeParams, 2> eyes;
+	// The cells of the left eye's image hidden by the lens, see hidden_area_mask.h.
+	// Empty if nothing is hidden
+	std::vector<uint8_t> left_hidden;
+	// The right eye's warped samples, a negative depth marks pixels no sample landed on
+	std::vector<uint32_t> warped_color;
+	std::vector<float> warped_depth;
+	// The right eye's pixels which are filled from the warped samples, shared with the camera
+	std::vector<uint8_t> reuse_mask;
+
+	void warp(const uint32_t *pixels, const float *depth, const std::array<uint32_t, 2> &eye_dims);
+	void update_mask(const std::array<uint32_t, 2> &eye_dims);
+
+public:
+	/* left_hidden_area is the left eye's hidden area mesh given to the camera,
+	 * empty if it has none
+	 */
+	StereoReprojection(const std::array<EyeParams, 2> &eyes,
+			const std::vector<ospcommon::vec2f> &left_hidden_area);
+
+	/* Render the frame with the camera, which must be the "vr" camera in stereo mode
+	 * with its pose already set. The framebuffer must have the color and depth channels.
+	 * The left eye is rendered without a deadline since all its samples are needed, the
+	 * right eye's tiles are cut off deadline_ms after the call (see VrTiledLoadBalancer)
+	 * if it's over 0. Any previous frame for the cut off tiles must already be set on the renderer.
+	 * The frame is written to pixels and, if not null, the ray distances to depth, both
+	 * with the eyes side by side like the framebuffer
+	 */
+	void render(OSPFrameBuffer fb, OspObjectState &renderer, OspObjectState &camera, uint32_t channels,
+			float deadline_ms, const std::array<uint32_t, 2> &eye_dims, uint32_t *pixels, float *depth);
+};
+
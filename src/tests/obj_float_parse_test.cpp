@@ -0,0 +1,96 @@
+/* Checks the OBJ loader's fast float parsing against its full parser on random
+ * tokens: wherever the fast path takes a token it must give the same float
+ * tryParseDouble rounds to, and it must find the same token end either way.
+ * Each token is at the very end of an exactly sized buffer, so building with
+ * -fsanitize=address also checks the block parsing doesn't read past the end.
+ */
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../tiny_obj_loader.h"
+
+static const size_t NUM_TOKENS = 2000000;
+
+static std::string random_token(std::mt19937 &rng) {
+	std::uniform_int_distribution<int> percent(0, 99);
+	std::uniform_int_distribution<int> digit(0, 9);
+	std::string token;
+	const int sign = percent(rng);
+	if (sign < 40) {
+		token += '-';
+	} else if (sign < 45) {
+		token += '+';
+	}
+	// Mostly the short decimals the fast path takes, with enough longer and
+	// malformed ones to exercise its fallbacks
+	const int integer_digits = std::uniform_int_distribution<int>(0, 8)(rng);
+	for (int i = 0; i < integer_digits; ++i) {
+		token += static_cast<char>('0' + digit(rng));
+	}
+	if (percent(rng) < 85) {
+		token += '.';
+		const int fraction_digits = std::uniform_int_distribution<int>(0, 9)(rng);
+		for (int i = 0; i < fraction_digits; ++i) {
+			token += static_cast<char>('0' + digit(rng));
+		}
+	}
+	const int extra = percent(rng);
+	if (extra < 5) {
+		token += 'e';
+		token += std::to_string(std::uniform_int_distribution<int>(-5, 5)(rng));
+	} else if (extra < 7) {
+		token += '.';
+	} else if (extra < 8) {
+		token += 'x';
+	}
+	return token;
+}
+
+int main() {
+	std::mt19937 rng(1234);
+	const char *delims[] = {"", " ", "\t", "\r", "\n", " 1.5"};
+	size_t fast_parsed = 0;
+	size_t failures = 0;
+	for (size_t i = 0; i < NUM_TOKENS && failures < 20; ++i) {
+		const std::string token = random_token(rng);
+		const std::string line = token + delims[i % 6];
+		// Exactly the line and its terminator, so any read past it is caught by ASan,
+		// and the line padded like the loader's line buffers so the block path is taken
+		std::vector<char> exact(line.begin(), line.end());
+		exact.push_back('\0');
+		std::vector<char> padded(exact);
+		padded.resize(padded.size() + tinyobj::kLinePadding, '\0');
+
+		const size_t expected_len = strcspn(exact.data(), " \t\r\n");
+		double expected = 0.0;
+		tinyobj::tryParseDouble(exact.data(), exact.data() + expected_len, &expected);
+		const float expected_f = static_cast<float>(expected);
+
+		const std::vector<char> *bufs[] = {&exact, &padded};
+		for (const std::vector<char> *buf : bufs) {
+			const char *s = buf->data();
+			const char *end = nullptr;
+			float f = 0.f;
+			const bool fast = tinyobj::tryParseFloatFast(s, s + buf->size(), &end, &f);
+			if (static_cast<size_t>(end - s) != expected_len) {
+				std::cerr << "Token '" << token << "' end at " << end - s
+					<< ", expected " << expected_len << "\n";
+				++failures;
+			} else if (fast && std::memcmp(&f, &expected_f, sizeof(float)) != 0) {
+				std::cerr.precision(9);
+				std::cerr << "Token '" << token << "' parsed to " << f
+					<< ", tryParseDouble gives " << expected_f << "\n";
+				++failures;
+			}
+			fast_parsed += fast;
+		}
+	}
+	std::cout << "Checked " << NUM_TOKENS << " tokens, " << fast_parsed
+		<< " fast path parses, " << failures << " failures\n";
+	return failures == 0 ? 0 : 1;
+}
+
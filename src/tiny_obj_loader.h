@@ -206,6 +206,10 @@ typedef struct {
                                                  // ... Up to 255.
   std::vector<int> material_ids;                 // per-face material ID
   std::vector<tag_t> tags;                       // SubD tag
+  // Packed triangle vertex (position) indices, 3 per triangle. Only filled
+  // when loading with `vertex_indices_only`, in which case `indices`,
+  // `num_face_vertices` and `material_ids` are left empty.
+  std::vector<int> vertex_indices;
 } mesh_t;
 
 typedef struct {
@@ -327,6 +331,38 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
              std::istream *inStream, MaterialReader *readMatFn = NULL,
              bool triangulate = true);
 
+/// Called by `LoadObjParallel` after each chunk of the file is merged, with
+/// the faces of the chunk as pieces of the shapes they belong to (a chunk can
+/// hold the end of one shape and the start of the next). `piece_shapes` gives
+/// the index of the shape each piece is part of, so the pieces of a shape can
+/// be merged again. `attrib` holds the attributes of this and the preceding
+/// chunks and is still being appended to, so it must not be referenced after
+/// the callback returns.
+/// Return false to cancel the load.
+typedef bool (*chunk_shapes_cb)(void *user_data, const attrib_t &attrib,
+                                const std::vector<shape_t> &pieces,
+                                const std::vector<size_t> &piece_shapes);
+
+/// Loads .obj from a file using multiple threads.
+/// The file is memory mapped and split into newline aligned chunks which are
+/// tokenized in place and parsed in parallel, the chunks are merged in order
+/// as they finish so the result is identical to `LoadObj` on the same file.
+/// 'num_threads' is optional, 0 uses all hardware threads.
+/// 'vertex_indices_only' is optional, when set the faces are triangulated and
+/// only their vertex indices are stored, packed in `mesh_t::vertex_indices`.
+/// This avoids storing the unused normal/texcoord indices and lets the
+/// indices be passed directly to renderers which take int3 index arrays.
+/// 'chunk_cb' is optional, it's called with each merged chunk's faces so they
+/// can be used before the whole file is loaded, and can cancel the load, in
+/// which case false is returned. When it's given `shapes` can be NULL if the
+/// callback keeps the faces itself, so they aren't stored twice.
+bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                     std::vector<material_t> *materials, std::string *err,
+                     const char *filename, const char *mtl_basedir = NULL,
+                     bool triangulate = true, int num_threads = 0,
+                     bool vertex_indices_only = false,
+                     chunk_shapes_cb chunk_cb = NULL, void *user_data = NULL);
+
 /// Loads materials into std::map
 void LoadMtl(std::map<std::string, int> *material_map,
              std::vector<material_t> *materials, std::istream *inStream,
@@ -341,12 +377,40 @@ void LoadMtl(std::map<std::string, int> *material_map,
 #include <cctype>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <utility>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <fstream>
+#include <mutex>
 #include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TINYOBJ_USE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 namespace tinyobj {
 
@@ -577,41 +641,199 @@ fail:
   return false;
 }
 
-static inline float parseFloat(const char **token, double default_value = 0.0) {
-  (*token) += strspn((*token), " \t");
-  const char *end = (*token) + strcspn((*token), " \t\r");
-  double val = default_value;
-  tryParseDouble((*token), end, &val);
-  float f = static_cast<float>(val);
+// Fast path for plain decimals "[sign] digits [. digits]", which is what
+// nearly every vertex coordinate is.
+//
+// The result is only computed when it's provably the same float
+// tryParseDouble would round to: at most 7 fraction digits and an integer
+// part below 2^17. For these tryParseDouble's result is within 9 ulp of the
+// exact value (in double), while the exact value is further than that
+// from any point halfway between two floats, so both round to the float
+// nearest the exact value. Multiplying the exact digits by 10^-f in double
+// is within 1 ulp, so it gives that nearest float too.
+static const int kFastFloatMaxIntegerDigits = 6;
+static const int kFastFloatMaxFractionDigits = 7;
+
+static inline bool decimalToFloat(uint64_t integer_part, uint64_t digits,
+                                  int fraction_digits, bool negative,
+                                  float *result) {
+  static const double pow10d[] = {1e0,  1e-1, 1e-2, 1e-3,
+                                  1e-4, 1e-5, 1e-6, 1e-7};
+  if (integer_part >= (uint64_t(1) << 17)) {
+    return false;
+  }
+  // The sign is applied without a branch since it's random in scan data
+  const double value =
+      static_cast<double>(digits) * pow10d[fraction_digits];
+  *result = static_cast<float>(negative ? -value : value);
+  return true;
+}
+
+#ifdef TINYOBJ_USE_SSE2
+static inline int countTrailingZeros(unsigned int x) {
+#ifdef _MSC_VER
+  unsigned long i;
+  _BitScanForward(&i, x);
+  return static_cast<int>(i);
+#else
+  return __builtin_ctz(x);
+#endif
+}
+
+// Converts the n < 8 digit characters at s, 8 bytes must be readable.
+// The digits are moved to the top of a little endian word so the unused
+// bytes become leading zeros, then pairs, quads and octets of digits are
+// combined with three multiplies. The shift is split in two so n = 0
+// works without a branch.
+static inline uint64_t parseDigitsSWAR(const char *s, int n) {
+  uint64_t w;
+  memcpy(&w, s, sizeof(w));
+  w = ((w & 0x0F0F0F0F0F0F0F0FULL) << (8 * (7 - n))) << 8;
+  w = (w * 10 + (w >> 8)) & 0x00FF00FF00FF00FFULL;
+  w = (w * 100 + (w >> 16)) & 0x0000FFFF0000FFFFULL;
+  return (w * 10000 + (w >> 32)) & 0xFFFFFFFFULL;
+}
+#endif
+
+// Bytes of padding after the terminator of the line buffers, so every float
+// on the line can be classified 16 characters at once.
+static const size_t kLinePadding = 16;
+
+// Finds the end of the float token starting at s (the same position as
+// strcspn(s, " \t\r\n")) and parses it directly if it's a plain decimal.
+// s_limit is the end of the memory that can be read from s, or NULL if
+// unknown. Returns false if the token has to go through tryParseDouble.
+static inline bool tryParseFloatFast(const char *s, const char *s_limit,
+                                     const char **s_end, float *result) {
+#ifdef TINYOBJ_USE_SSE2
+  // Classify 16 characters at once if they're all readable
+  if (s_limit && s_limit - s >= 16) {
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+    const __m128i delim = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(c, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\r')),
+                                  _mm_cmpeq_epi8(c, _mm_set1_epi8('\n'))),
+                     _mm_cmpeq_epi8(c, _mm_setzero_si128())));
+    const unsigned int delim_mask =
+        static_cast<unsigned int>(_mm_movemask_epi8(delim));
+    if (delim_mask != 0) {
+      const int len = countTrailingZeros(delim_mask);
+      *s_end = s + len;
+
+      // Unsigned c - '0' < 10, done as a signed compare
+      const __m128i digit = _mm_cmplt_epi8(
+          _mm_xor_si128(_mm_sub_epi8(c, _mm_set1_epi8('0')),
+                        _mm_set1_epi8(static_cast<char>(0x80))),
+          _mm_set1_epi8(static_cast<char>(0x80 + 10)));
+      const unsigned int digit_mask =
+          static_cast<unsigned int>(_mm_movemask_epi8(digit));
+      const unsigned int dot_mask = static_cast<unsigned int>(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('.'))));
+
+      const bool negative = *s == '-';
+      const int start = static_cast<int>(negative) + static_cast<int>(*s == '+');
+      const unsigned int token_mask = ((1u << len) - 1) & ~((1u << start) - 1);
+      const unsigned int other = token_mask & ~digit_mask;
+      // Anything but digits with at most one '.' goes to tryParseDouble
+      if (other != 0 && (other != (dot_mask & token_mask) ||
+                         (other & (other - 1)) != 0)) {
+        return false;
+      }
+      const int dot = other != 0 ? countTrailingZeros(other) : len;
+      const int integer_digits = dot - start;
+      const int fraction_digits = other != 0 ? len - dot - 1 : 0;
+      if (integer_digits == 0 ||
+          integer_digits > kFastFloatMaxIntegerDigits ||
+          fraction_digits > kFastFloatMaxFractionDigits) {
+        return false;
+      }
+      // Both 8 byte reads stay within the 16 we checked are readable
+      static const uint64_t pow10[] = {1,      10,      100,     1000,
+                                       10000,  100000,  1000000, 10000000};
+      const uint64_t integer_part = parseDigitsSWAR(s + start, integer_digits);
+      const uint64_t digits =
+          integer_part * pow10[fraction_digits] +
+          parseDigitsSWAR(s + dot + 1, fraction_digits);
+      return decimalToFloat(integer_part, digits, fraction_digits, negative,
+                            result);
+    }
+  }
+#endif
+  *s_end = s + strcspn(s, " \t\r\n");
+  const char *curr = s;
+  const bool negative = curr != *s_end && *curr == '-';
+  if (curr != *s_end && (*curr == '-' || *curr == '+')) {
+    curr++;
+  }
+  uint64_t digits = 0;
+  int integer_digits = 0;
+  for (; curr != *s_end && IS_DIGIT(*curr); ++curr, ++integer_digits) {
+    digits = digits * 10 + static_cast<unsigned int>(*curr - '0');
+  }
+  const uint64_t integer_part = digits;
+  int fraction_digits = 0;
+  if (curr != *s_end && *curr == '.') {
+    for (++curr; curr != *s_end && IS_DIGIT(*curr); ++curr, ++fraction_digits) {
+      digits = digits * 10 + static_cast<unsigned int>(*curr - '0');
+    }
+  }
+  if (curr != *s_end || integer_digits == 0 ||
+      integer_digits > kFastFloatMaxIntegerDigits ||
+      fraction_digits > kFastFloatMaxFractionDigits) {
+    return false;
+  }
+  return decimalToFloat(integer_part, digits, fraction_digits, negative,
+                        result);
+}
+
+// The token may also be in a buffer holding multiple lines, e.g. a memory
+// mapped file, so '\n' also ends it. limit is the end of the memory that can
+// be read from the token, or NULL if unknown.
+static inline float parseFloat(const char **token, double default_value = 0.0,
+                               const char *limit = NULL) {
+  while (IS_SPACE(**token)) {
+    (*token)++;
+  }
+  const char *end = NULL;
+  float f;
+  if (!tryParseFloatFast((*token), limit, &end, &f)) {
+    double val = default_value;
+    tryParseDouble((*token), end, &val);
+    f = static_cast<float>(val);
+  }
   (*token) = end;
   return f;
 }
 
 static inline void parseFloat2(float *x, float *y, const char **token,
                                const double default_x = 0.0,
-                               const double default_y = 0.0) {
-  (*x) = parseFloat(token, default_x);
-  (*y) = parseFloat(token, default_y);
+                               const double default_y = 0.0,
+                               const char *limit = NULL) {
+  (*x) = parseFloat(token, default_x, limit);
+  (*y) = parseFloat(token, default_y, limit);
 }
 
 static inline void parseFloat3(float *x, float *y, float *z, const char **token,
                                const double default_x = 0.0,
                                const double default_y = 0.0,
-                               const double default_z = 0.0) {
-  (*x) = parseFloat(token, default_x);
-  (*y) = parseFloat(token, default_y);
-  (*z) = parseFloat(token, default_z);
+                               const double default_z = 0.0,
+                               const char *limit = NULL) {
+  (*x) = parseFloat(token, default_x, limit);
+  (*y) = parseFloat(token, default_y, limit);
+  (*z) = parseFloat(token, default_z, limit);
 }
 
 static inline void parseV(float *x, float *y, float *z, float *w,
                           const char **token, const double default_x = 0.0,
                           const double default_y = 0.0,
                           const double default_z = 0.0,
-                          const double default_w = 1.0) {
-  (*x) = parseFloat(token, default_x);
-  (*y) = parseFloat(token, default_y);
-  (*z) = parseFloat(token, default_z);
-  (*w) = parseFloat(token, default_w);
+                          const double default_w = 1.0,
+                          const char *limit = NULL) {
+  (*x) = parseFloat(token, default_x, limit);
+  (*y) = parseFloat(token, default_y, limit);
+  (*z) = parseFloat(token, default_z, limit);
+  (*w) = parseFloat(token, default_w, limit);
 }
 
 static inline bool parseOnOff(const char **token, bool default_value = true) {
@@ -745,6 +967,72 @@ static vertex_index parseRawTriple(const char **token) {
   return vi;
 }
 
+// Parse an index like atoi, but without skipping line breaks so it can't
+// read into the next line of a multi line buffer.
+static inline int parseIndex(const char *p) {
+  while (*p == ' ' || *p == '\t' || *p == '\v' || *p == '\f') {
+    p++;
+  }
+  int sign = 1;
+  if (*p == '+' || *p == '-') {
+    sign = *p == '-' ? -1 : 1;
+    p++;
+  }
+  int i = 0;
+  while (IS_DIGIT(*p)) {
+    i = i * 10 + (*p - '0');
+    p++;
+  }
+  return sign * i;
+}
+
+// Parse triples with index offsets like `parseTriple`, additionally flags
+// which indices were relative (negative) in `relative`:
+// bit 0 = vertex, bit 1 = texcoord, bit 2 = normal.
+// The triple may be in a multi line buffer, parsing stops at the line end.
+static vertex_index parseTripleRelative(const char **token, int vsize,
+                                        int vnsize, int vtsize,
+                                        int *relative) {
+  vertex_index vi(-1);
+  (*relative) = 0;
+
+  int idx = parseIndex((*token));
+  (*relative) |= idx < 0 ? 1 : 0;
+  vi.v_idx = fixIndex(idx, vsize);
+  (*token) += strcspn((*token), "/ \t\r\n");
+  if ((*token)[0] != '/') {
+    return vi;
+  }
+  (*token)++;
+
+  // i//k
+  if ((*token)[0] == '/') {
+    (*token)++;
+    idx = parseIndex((*token));
+    (*relative) |= idx < 0 ? 4 : 0;
+    vi.vn_idx = fixIndex(idx, vnsize);
+    (*token) += strcspn((*token), "/ \t\r\n");
+    return vi;
+  }
+
+  // i/j/k or i/j
+  idx = parseIndex((*token));
+  (*relative) |= idx < 0 ? 2 : 0;
+  vi.vt_idx = fixIndex(idx, vtsize);
+  (*token) += strcspn((*token), "/ \t\r\n");
+  if ((*token)[0] != '/') {
+    return vi;
+  }
+
+  // i/j/k
+  (*token)++;  // skip '/'
+  idx = parseIndex((*token));
+  (*relative) |= idx < 0 ? 4 : 0;
+  vi.vn_idx = fixIndex(idx, vnsize);
+  (*token) += strcspn((*token), "/ \t\r\n");
+  return vi;
+}
+
 static bool ParseTextureNameAndOption(std::string *texname,
                                       texture_option_t *texopt,
                                       const char *linebuf, const bool is_bump) {
@@ -878,60 +1166,146 @@ static void InitMaterial(material_t *material) {
   material->unknown_parameter.clear();
 }
 
-static bool exportFaceGroupToShape(
-    shape_t *shape, const std::vector<std::vector<vertex_index> > &faceGroup,
-    const std::vector<tag_t> &tags, const int material_id,
-    const std::string &name, bool triangulate) {
+// A run of consecutive faces stored back to back in flat arrays.
+struct face_span {
+  const vertex_index *vertices;
+  const int *num_vertices;  // per face
+  size_t num_faces;
+};
+
+// The faces of a group stored back to back. It's cleared rather than freed
+// between groups, so parsing faces doesn't allocate once it has grown to the
+// size of the largest group.
+struct face_group {
+  std::vector<vertex_index> vertices;
+  std::vector<int> num_vertices;  // per face
+
+  bool empty() const { return num_vertices.empty(); }
+  void clear() {
+    vertices.clear();
+    num_vertices.clear();
+  }
+};
+
+// Reserve space for n more elements, growing geometrically so repeated
+// appends to the same shape (e.g. one per `usemtl`) stay amortized.
+template <typename T>
+static void reserveAppend(std::vector<T> *vec, size_t n) {
+  const size_t size = vec->size() + n;
+  if (size > vec->capacity()) {
+    vec->reserve(std::max(size, 2 * vec->capacity()));
+  }
+}
+
+// Append the faces in the spans to the shape's mesh. The output arrays are
+// sized up front from the face vertex counts. If `vertex_indices_only` is set
+// the faces are triangulated into `mesh.vertex_indices`.
+static bool exportFaceSpansToShape(shape_t *shape,
+                                   const std::vector<face_span> &faceGroup,
+                                   const std::vector<tag_t> &tags,
+                                   const int material_id,
+                                   const std::string &name, bool triangulate,
+                                   bool vertex_indices_only = false) {
   if (faceGroup.empty()) {
     return false;
   }
 
-  // Flatten vertices and indices
-  for (size_t i = 0; i < faceGroup.size(); i++) {
-    const std::vector<vertex_index> &face = faceGroup[i];
-
-    vertex_index i0 = face[0];
-    vertex_index i1(-1);
-    vertex_index i2 = face[1];
-
-    size_t npolys = face.size();
-
-    if (triangulate) {
-      // Polygon -> triangle fan conversion
-      for (size_t k = 2; k < npolys; k++) {
-        i1 = i2;
-        i2 = face[k];
-
-        index_t idx0, idx1, idx2;
-        idx0.vertex_index = i0.v_idx;
-        idx0.normal_index = i0.vn_idx;
-        idx0.texcoord_index = i0.vt_idx;
-        idx1.vertex_index = i1.v_idx;
-        idx1.normal_index = i1.vn_idx;
-        idx1.texcoord_index = i1.vt_idx;
-        idx2.vertex_index = i2.v_idx;
-        idx2.normal_index = i2.vn_idx;
-        idx2.texcoord_index = i2.vt_idx;
-
-        shape->mesh.indices.push_back(idx0);
-        shape->mesh.indices.push_back(idx1);
-        shape->mesh.indices.push_back(idx2);
-
-        shape->mesh.num_face_vertices.push_back(3);
-        shape->mesh.material_ids.push_back(material_id);
+  size_t num_faces = 0;
+  size_t num_indices = 0;
+  size_t num_triangles = 0;
+  for (size_t s = 0; s < faceGroup.size(); s++) {
+    const face_span &span = faceGroup[s];
+    num_faces += span.num_faces;
+    for (size_t i = 0; i < span.num_faces; i++) {
+      num_indices += static_cast<size_t>(span.num_vertices[i]);
+      if (span.num_vertices[i] > 2) {
+        num_triangles += static_cast<size_t>(span.num_vertices[i] - 2);
       }
-    } else {
-      for (size_t k = 0; k < npolys; k++) {
-        index_t idx;
-        idx.vertex_index = face[k].v_idx;
-        idx.normal_index = face[k].vn_idx;
-        idx.texcoord_index = face[k].vt_idx;
-        shape->mesh.indices.push_back(idx);
+    }
+  }
+  if (vertex_indices_only) {
+    reserveAppend(&shape->mesh.vertex_indices, num_triangles * 3);
+  } else if (triangulate) {
+    reserveAppend(&shape->mesh.indices, num_triangles * 3);
+    reserveAppend(&shape->mesh.num_face_vertices, num_triangles);
+    reserveAppend(&shape->mesh.material_ids, num_triangles);
+  } else {
+    reserveAppend(&shape->mesh.indices, num_indices);
+    reserveAppend(&shape->mesh.num_face_vertices, num_faces);
+    reserveAppend(&shape->mesh.material_ids, num_faces);
+  }
+
+  if (vertex_indices_only) {
+    for (size_t s = 0; s < faceGroup.size(); s++) {
+      const face_span &span = faceGroup[s];
+      const vertex_index *face = span.vertices;
+      for (size_t i = 0; i < span.num_faces;
+           face += span.num_vertices[i], i++) {
+        const int npolys = span.num_vertices[i];
+        // Polygon -> triangle fan conversion
+        for (int k = 2; k < npolys; k++) {
+          shape->mesh.vertex_indices.push_back(face[0].v_idx);
+          shape->mesh.vertex_indices.push_back(face[k - 1].v_idx);
+          shape->mesh.vertex_indices.push_back(face[k].v_idx);
+        }
       }
+    }
+    shape->name = name;
+    shape->mesh.tags = tags;
+    return true;
+  }
 
-      shape->mesh.num_face_vertices.push_back(
-          static_cast<unsigned char>(npolys));
-      shape->mesh.material_ids.push_back(material_id);  // per face
+  // Flatten vertices and indices
+  for (size_t s = 0; s < faceGroup.size(); s++) {
+    const face_span &span = faceGroup[s];
+    const vertex_index *face = span.vertices;
+    for (size_t i = 0; i < span.num_faces; face += span.num_vertices[i], i++) {
+      size_t npolys = static_cast<size_t>(span.num_vertices[i]);
+
+      if (triangulate) {
+        if (npolys < 3) {
+          continue;
+        }
+        vertex_index i0 = face[0];
+        vertex_index i1(-1);
+        vertex_index i2 = face[1];
+
+        // Polygon -> triangle fan conversion
+        for (size_t k = 2; k < npolys; k++) {
+          i1 = i2;
+          i2 = face[k];
+
+          index_t idx0, idx1, idx2;
+          idx0.vertex_index = i0.v_idx;
+          idx0.normal_index = i0.vn_idx;
+          idx0.texcoord_index = i0.vt_idx;
+          idx1.vertex_index = i1.v_idx;
+          idx1.normal_index = i1.vn_idx;
+          idx1.texcoord_index = i1.vt_idx;
+          idx2.vertex_index = i2.v_idx;
+          idx2.normal_index = i2.vn_idx;
+          idx2.texcoord_index = i2.vt_idx;
+
+          shape->mesh.indices.push_back(idx0);
+          shape->mesh.indices.push_back(idx1);
+          shape->mesh.indices.push_back(idx2);
+
+          shape->mesh.num_face_vertices.push_back(3);
+          shape->mesh.material_ids.push_back(material_id);
+        }
+      } else {
+        for (size_t k = 0; k < npolys; k++) {
+          index_t idx;
+          idx.vertex_index = face[k].v_idx;
+          idx.normal_index = face[k].vn_idx;
+          idx.texcoord_index = face[k].vt_idx;
+          shape->mesh.indices.push_back(idx);
+        }
+
+        shape->mesh.num_face_vertices.push_back(
+            static_cast<unsigned char>(npolys));
+        shape->mesh.material_ids.push_back(material_id);  // per face
+      }
     }
   }
 
@@ -941,6 +1315,21 @@ static bool exportFaceGroupToShape(
   return true;
 }
 
+static bool exportFaceGroupToShape(shape_t *shape, const face_group &faceGroup,
+                                   const std::vector<tag_t> &tags,
+                                   const int material_id,
+                                   const std::string &name, bool triangulate) {
+  if (faceGroup.empty()) {
+    return false;
+  }
+  face_span span;
+  span.vertices = faceGroup.vertices.data();
+  span.num_vertices = faceGroup.num_vertices.data();
+  span.num_faces = faceGroup.num_vertices.size();
+  return exportFaceSpansToShape(shape, std::vector<face_span>(1, span), tags,
+                                material_id, name, triangulate);
+}
+
 // Split a string with specified delimiter character.
 // http://stackoverflow.com/questions/236129/split-a-string-in-c
 static void SplitString(const std::string &s, char delim,
@@ -1422,7 +1811,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   std::vector<float> vn;
   std::vector<float> vt;
   std::vector<tag_t> tags;
-  std::vector<std::vector<vertex_index> > faceGroup;
+  face_group faceGroup;
   std::string name;
 
   // material
@@ -1450,6 +1839,10 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       continue;
     }
 
+    // Pad the line so the floats on it can be parsed a block at a time
+    linebuf.append(kLinePadding, '\0');
+    const char *line_limit = linebuf.c_str() + linebuf.size();
+
     // Skip leading space.
     const char *token = linebuf.c_str();
     token += strspn(token, " \t");
@@ -1463,7 +1856,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     if (token[0] == 'v' && IS_SPACE((token[1]))) {
       token += 2;
       float x, y, z;
-      parseFloat3(&x, &y, &z, &token);
+      parseFloat3(&x, &y, &z, &token, 0.0, 0.0, 0.0, line_limit);
       v.push_back(x);
       v.push_back(y);
       v.push_back(z);
@@ -1474,7 +1867,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
       token += 3;
       float x, y, z;
-      parseFloat3(&x, &y, &z, &token);
+      parseFloat3(&x, &y, &z, &token, 0.0, 0.0, 0.0, line_limit);
       vn.push_back(x);
       vn.push_back(y);
       vn.push_back(z);
@@ -1485,7 +1878,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
       token += 3;
       float x, y;
-      parseFloat2(&x, &y, &token);
+      parseFloat2(&x, &y, &token, 0.0, 0.0, line_limit);
       vt.push_back(x);
       vt.push_back(y);
       continue;
@@ -1496,21 +1889,17 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       token += 2;
       token += strspn(token, " \t");
 
-      std::vector<vertex_index> face;
-      face.reserve(3);
-
+      const size_t first_vertex = faceGroup.vertices.size();
       while (!IS_NEW_LINE(token[0])) {
         vertex_index vi = parseTriple(&token, static_cast<int>(v.size() / 3),
                                       static_cast<int>(vn.size() / 3),
                                       static_cast<int>(vt.size() / 2));
-        face.push_back(vi);
+        faceGroup.vertices.push_back(vi);
         size_t n = strspn(token, " \t\r");
         token += n;
       }
-
-      // replace with emplace_back + std::move on C++11
-      faceGroup.push_back(std::vector<vertex_index>());
-      faceGroup[faceGroup.size() - 1].swap(face);
+      faceGroup.num_vertices.push_back(
+          static_cast<int>(faceGroup.vertices.size() - first_vertex));
 
       continue;
     }
@@ -1594,7 +1983,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       bool ret = exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
                                         triangulate);
       if (ret) {
-        shapes->push_back(shape);
+        shapes->push_back(std::move(shape));
       }
 
       shape = shape_t();
@@ -1629,7 +2018,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
       bool ret = exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
                                         triangulate);
       if (ret) {
-        shapes->push_back(shape);
+        shapes->push_back(std::move(shape));
       }
 
       // material = -1;
@@ -1705,7 +2094,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   // we also add `shape` to `shapes` when `shape.mesh` has already some
   // faces(indices)
   if (ret || shape.mesh.indices.size()) {
-    shapes->push_back(shape);
+    shapes->push_back(std::move(shape));
   }
   faceGroup.clear();  // for safety
 
@@ -1756,6 +2145,10 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
       continue;
     }
 
+    // Pad the line so the floats on it can be parsed a block at a time
+    linebuf.append(kLinePadding, '\0');
+    const char *line_limit = linebuf.c_str() + linebuf.size();
+
     // Skip leading space.
     const char *token = linebuf.c_str();
     token += strspn(token, " \t");
@@ -1769,7 +2162,7 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
     if (token[0] == 'v' && IS_SPACE((token[1]))) {
       token += 2;
       float x, y, z, w;  // w is optional. default = 1.0
-      parseV(&x, &y, &z, &w, &token);
+      parseV(&x, &y, &z, &w, &token, 0.0, 0.0, 0.0, 1.0, line_limit);
       if (callback.vertex_cb) {
         callback.vertex_cb(user_data, x, y, z, w);
       }
@@ -1780,7 +2173,7 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
     if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
       token += 3;
       float x, y, z;
-      parseFloat3(&x, &y, &z, &token);
+      parseFloat3(&x, &y, &z, &token, 0.0, 0.0, 0.0, line_limit);
       if (callback.normal_cb) {
         callback.normal_cb(user_data, x, y, z);
       }
@@ -1791,7 +2184,7 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
     if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
       token += 3;
       float x, y, z;  // y and z are optional. default = 0.0
-      parseFloat3(&x, &y, &z, &token);
+      parseFloat3(&x, &y, &z, &token, 0.0, 0.0, 0.0, line_limit);
       if (callback.texcoord_cb) {
         callback.texcoord_cb(user_data, x, y, z);
       }
@@ -2015,6 +2408,741 @@ bool LoadObjWithCallback(std::istream &inStream, const callback_t &callback,
 
   return true;
 }
+// Read only memory mapping of a file.
+class MappedFile {
+ public:
+  MappedFile() : data_(NULL), size_(0) {
+#ifdef _WIN32
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = NULL;
+#endif
+  }
+  ~MappedFile() { close(); }
+
+  bool open(const char *filename) {
+    close();
+#ifdef _WIN32
+    file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size)) {
+      close();
+      return false;
+    }
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    // Empty files can't be mapped
+    if (size_ == 0) {
+      return true;
+    }
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping_) {
+      close();
+      return false;
+    }
+    data_ = static_cast<const char *>(
+        MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+      close();
+      return false;
+    }
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (fd == -1) {
+      return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) == -1) {
+      ::close(fd);
+      return false;
+    }
+    size_ = static_cast<size_t>(sb.st_size);
+    // Empty files can't be mapped
+    if (size_ == 0) {
+      ::close(fd);
+      return true;
+    }
+    void *data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      size_ = 0;
+      return false;
+    }
+    madvise(data, size_, MADV_WILLNEED);
+    data_ = static_cast<const char *>(data);
+#endif
+    return true;
+  }
+
+  void close() {
+#ifdef _WIN32
+    if (data_) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+      CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+    }
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = NULL;
+#else
+    if (data_) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+    data_ = NULL;
+    size_ = 0;
+  }
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  const char *data_;
+  size_t size_;
+#ifdef _WIN32
+  HANDLE file_;
+  HANDLE mapping_;
+#endif
+};
+
+// A usemtl, mtllib, g, o or t line found while parsing a chunk. These change
+// the shape and material state so they're replayed in file order when the
+// chunks are merged.
+struct obj_statement {
+  size_t face;  // Number of faces in the chunk preceding the statement
+  std::string line;
+};
+
+// Attributes, faces and statements parsed from a newline aligned chunk of
+// an .obj file by `LoadObjParallel`.
+struct obj_chunk {
+  std::vector<float> v;
+  std::vector<float> vn;
+  std::vector<float> vt;
+  std::vector<vertex_index> face_vertices;
+  std::vector<int> face_num_vertices;
+  // Positions in `face_vertices` of relative (negative) indices. These were
+  // resolved against the chunk's own attribute counts and are offset by the
+  // number of attributes in the preceding chunks when merging.
+  std::vector<size_t> rel_v;
+  std::vector<size_t> rel_vn;
+  std::vector<size_t> rel_vt;
+  std::vector<obj_statement> statements;
+};
+
+// Joins the worker threads of `LoadObjParallel` when leaving its scope, also
+// when unwinding from an exception, since destroying a joinable std::thread
+// terminates. The workers are told to stop taking chunks first.
+struct obj_worker_joiner {
+  std::vector<std::thread> *workers;
+  std::atomic<bool> *stop;
+
+  void join() {
+    (*stop) = true;
+    for (size_t t = 0; t < workers->size(); t++) {
+      if ((*workers)[t].joinable()) {
+        (*workers)[t].join();
+      }
+    }
+  }
+  ~obj_worker_joiner() { join(); }
+};
+
+// Export the faces in `pieceGroup` as a piece of the current shape for the
+// `chunk_cb` of `LoadObjParallel`.
+static void exportPiece(std::vector<shape_t> *pieces,
+                        std::vector<size_t> *piece_shapes, size_t shape_index,
+                        std::vector<face_span> *pieceGroup,
+                        const std::vector<tag_t> &tags, const int material_id,
+                        const std::string &name, bool triangulate,
+                        bool vertex_indices_only) {
+  if (pieceGroup->empty()) {
+    return;
+  }
+  pieces->push_back(shape_t());
+  piece_shapes->push_back(shape_index);
+  exportFaceSpansToShape(&pieces->back(), *pieceGroup, tags, material_id, name,
+                         triangulate, vertex_indices_only);
+  pieceGroup->clear();
+}
+
+// Find the end of the line starting at `p`, lines are ended by '\n', '\r' or
+// "\r\n" like in `safeGetline`. `next` is set to the start of the next line.
+static const char *findLineEnd(const char *p, const char *end,
+                               const char **next) {
+  while (p != end && *p != '\n' && *p != '\r') {
+    p++;
+  }
+  if (p == end) {
+    (*next) = end;
+    return end;
+  }
+  (*next) = p + 1;
+  if (*p == '\r' && (*next) != end && (**next) == '\n') {
+    (*next)++;
+  }
+  return p;
+}
+
+// Parses the lines in [begin, end) in place, tokens are delimited by the
+// line endings instead of copying each line into a null terminated string.
+static void parseObjChunk(obj_chunk *chunk, const char *begin,
+                          const char *end) {
+  std::string linebuf;
+  const char *next = begin;
+  for (const char *line = begin; line != end; line = next) {
+    const char *line_end = findLineEnd(line, end, &next);
+
+    // Skip if empty line.
+    if (line == line_end) {
+      continue;
+    }
+
+    // The last line of the file may not have a line ending, copy it into a
+    // padded buffer so parsing it doesn't read past the end of the file.
+    // The other lines can be read up to the end of the chunk.
+    const char *token = line;
+    const char *line_limit = end;
+    if (line_end == end) {
+      linebuf.assign(line, line_end);
+      linebuf.append(kLinePadding, '\0');
+      token = linebuf.c_str();
+      line_end = token + (line_end - line);
+      line_limit = token + linebuf.size();
+    }
+
+    // Skip leading space.
+    token += strspn(token, " \t");
+
+    assert(token);
+    if (IS_NEW_LINE(token[0])) continue;  // empty line
+
+    if (token[0] == '#') continue;  // comment line
+
+    // vertex
+    if (token[0] == 'v' && IS_SPACE((token[1]))) {
+      token += 2;
+      float x, y, z;
+      parseFloat3(&x, &y, &z, &token, 0.0, 0.0, 0.0, line_limit);
+      chunk->v.push_back(x);
+      chunk->v.push_back(y);
+      chunk->v.push_back(z);
+      continue;
+    }
+
+    // normal
+    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+      token += 3;
+      float x, y, z;
+      parseFloat3(&x, &y, &z, &token, 0.0, 0.0, 0.0, line_limit);
+      chunk->vn.push_back(x);
+      chunk->vn.push_back(y);
+      chunk->vn.push_back(z);
+      continue;
+    }
+
+    // texcoord
+    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+      token += 3;
+      float x, y;
+      parseFloat2(&x, &y, &token, 0.0, 0.0, line_limit);
+      chunk->vt.push_back(x);
+      chunk->vt.push_back(y);
+      continue;
+    }
+
+    // face
+    if (token[0] == 'f' && IS_SPACE((token[1]))) {
+      token += 2;
+      token += strspn(token, " \t");
+
+      int num_vertices = 0;
+      while (!IS_NEW_LINE(token[0])) {
+        int relative = 0;
+        vertex_index vi = parseTripleRelative(
+            &token, static_cast<int>(chunk->v.size() / 3),
+            static_cast<int>(chunk->vn.size() / 3),
+            static_cast<int>(chunk->vt.size() / 2), &relative);
+        if (relative) {
+          const size_t pos = chunk->face_vertices.size();
+          if (relative & 1) chunk->rel_v.push_back(pos);
+          if (relative & 2) chunk->rel_vt.push_back(pos);
+          if (relative & 4) chunk->rel_vn.push_back(pos);
+        }
+        chunk->face_vertices.push_back(vi);
+        num_vertices++;
+        size_t n = strspn(token, " \t");
+        token += n;
+      }
+      chunk->face_num_vertices.push_back(num_vertices);
+
+      continue;
+    }
+
+    if (((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) ||
+        ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) ||
+        (token[0] == 'g' && IS_SPACE((token[1]))) ||
+        (token[0] == 'o' && IS_SPACE((token[1]))) ||
+        (token[0] == 't' && IS_SPACE((token[1])))) {
+      obj_statement statement;
+      statement.face = chunk->face_num_vertices.size();
+      statement.line = std::string(token, line_end);
+      chunk->statements.push_back(statement);
+    }
+
+    // Ignore unknown command.
+  }
+}
+
+bool LoadObjParallel(attrib_t *attrib, std::vector<shape_t> *shapes,
+                     std::vector<material_t> *materials, std::string *err,
+                     const char *filename, const char *mtl_basedir,
+                     bool triangulate, int num_threads,
+                     bool vertex_indices_only, chunk_shapes_cb chunk_cb,
+                     void *user_data) {
+  attrib->vertices.clear();
+  attrib->normals.clear();
+  attrib->texcoords.clear();
+  if (shapes) {
+    shapes->clear();
+  } else if (!chunk_cb) {
+    if (err) {
+      (*err) = "No shapes or chunk callback given\n";
+    }
+    return false;
+  }
+
+  std::stringstream errss;
+
+  MappedFile file;
+  if (!file.open(filename)) {
+    errss << "Cannot open file [" << filename << "]" << std::endl;
+    if (err) {
+      (*err) = errss.str();
+    }
+    return false;
+  }
+  const size_t file_size = file.size();
+  const char *file_begin = file.data();
+  const char *file_end = file_begin + file_size;
+
+  std::string baseDir;
+  if (mtl_basedir) {
+    baseDir = mtl_basedir;
+  }
+  MaterialFileReader matFileReader(baseDir);
+  MaterialReader *readMatFn = &matFileReader;
+
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  num_threads = std::max(num_threads, 1);
+
+  // Split the file into a few chunks per thread to balance the load, but
+  // don't bother splitting it into tiny pieces
+  const size_t min_chunk_size = 1 << 20;
+  const size_t num_chunks =
+      std::max(std::min(static_cast<size_t>(num_threads) * 4,
+                        file_size / min_chunk_size),
+               static_cast<size_t>(1));
+
+  // Move each split point forward to the start of the next line
+  std::vector<const char *> bounds(num_chunks + 1, file_end);
+  bounds[0] = file_begin;
+  for (size_t c = 1; c < num_chunks; c++) {
+    const char *split = file_begin + (file_size / num_chunks) * c;
+    split = std::max(split, bounds[c - 1]);
+    if (split != file_end) {
+      findLineEnd(split, file_end, &split);
+    }
+    bounds[c] = split;
+  }
+
+  // The chunks are parsed in parallel and merged in order on this thread as
+  // they finish, the workers take them in order so the merge keeps up
+  std::vector<obj_chunk> chunks(num_chunks);
+  std::vector<char> chunk_parsed(num_chunks, 0);
+  std::mutex parsed_mutex;
+  std::condition_variable parsed_cv;
+  std::atomic<size_t> next_chunk(0);
+  std::atomic<bool> stop_workers(false);
+  // The first exception thrown by a worker, rethrown after joining them
+  std::exception_ptr worker_error;
+  std::vector<std::thread> workers;
+  obj_worker_joiner joiner = {&workers, &stop_workers};
+  const size_t num_workers =
+      std::min(static_cast<size_t>(num_threads), num_chunks);
+  for (size_t t = 0; t < num_workers; t++) {
+    workers.push_back(std::thread([&]() {
+      for (size_t c = next_chunk++; c < num_chunks && !stop_workers;
+           c = next_chunk++) {
+        std::exception_ptr error;
+        try {
+          parseObjChunk(&chunks[c], bounds[c], bounds[c + 1]);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(parsed_mutex);
+        if (error && !worker_error) {
+          worker_error = error;
+          stop_workers = true;
+        }
+        chunk_parsed[c] = 1;
+        parsed_cv.notify_all();
+      }
+    }));
+  }
+
+  // Replay the faces and statements in file order to build the shapes
+  std::vector<tag_t> tags;
+  std::vector<face_span> faceGroup;
+  std::string name;
+
+  // material
+  std::map<std::string, int> material_map;
+  int material = -1;
+
+  shape_t shape;
+  // The faces of `faceGroup` are added to `shape` at the end of each chunk so
+  // the chunk can be freed, this tracks if it would still have had faces
+  bool shapeHasGroupFaces = false;
+  // Tracks if `shape` has faces when they're only passed to `chunk_cb`
+  // instead of being added to it
+  bool shapeHasFaces = false;
+  size_t numShapes = 0;
+  bool cancelled = false;
+
+  // The faces of the current chunk for `chunk_cb`, split into pieces of
+  // shapes where the shapes are exported
+  std::vector<face_span> pieceGroup;
+  std::vector<shape_t> pieces;
+  std::vector<size_t> pieceShapes;
+
+  // Add the faces of `faceGroup` to `shape`, returns false if there are none
+  auto addGroupToShape = [&]() {
+    if (faceGroup.empty()) {
+      return false;
+    }
+    if (shapes) {
+      exportFaceSpansToShape(&shape, faceGroup, tags, material, name,
+                             triangulate, vertex_indices_only);
+    }
+    shapeHasFaces = true;
+    return true;
+  };
+  auto pushShape = [&]() {
+    if (shapes) {
+      shapes->push_back(std::move(shape));
+    }
+    numShapes++;
+  };
+
+  for (size_t c = 0; c < num_chunks; c++) {
+    {
+      std::unique_lock<std::mutex> lock(parsed_mutex);
+      while (!chunk_parsed[c] && !worker_error) {
+        parsed_cv.wait(lock);
+      }
+      if (worker_error) {
+        break;
+      }
+    }
+
+    // Append the chunk's attributes and rebase its relative indices by the
+    // number of attributes in the preceding chunks
+    obj_chunk &chunk = chunks[c];
+    const int base_v = static_cast<int>(attrib->vertices.size() / 3);
+    const int base_vn = static_cast<int>(attrib->normals.size() / 3);
+    const int base_vt = static_cast<int>(attrib->texcoords.size() / 2);
+    for (size_t i = 0; i < chunk.rel_v.size(); i++) {
+      chunk.face_vertices[chunk.rel_v[i]].v_idx += base_v;
+    }
+    for (size_t i = 0; i < chunk.rel_vn.size(); i++) {
+      chunk.face_vertices[chunk.rel_vn[i]].vn_idx += base_vn;
+    }
+    for (size_t i = 0; i < chunk.rel_vt.size(); i++) {
+      chunk.face_vertices[chunk.rel_vt[i]].vt_idx += base_vt;
+    }
+    attrib->vertices.insert(attrib->vertices.end(), chunk.v.begin(),
+                            chunk.v.end());
+    attrib->normals.insert(attrib->normals.end(), chunk.vn.begin(),
+                           chunk.vn.end());
+    attrib->texcoords.insert(attrib->texcoords.end(), chunk.vt.begin(),
+                             chunk.vt.end());
+    std::vector<float>().swap(chunk.v);
+    std::vector<float>().swap(chunk.vn);
+    std::vector<float>().swap(chunk.vt);
+
+    // Replay the chunk's faces and statements
+    size_t face = 0;
+    size_t face_vertex = 0;
+    for (size_t st = 0; st <= chunk.statements.size(); st++) {
+      // Add the faces preceding this statement to the face group
+      const size_t face_end = st < chunk.statements.size()
+                                  ? chunk.statements[st].face
+                                  : chunk.face_num_vertices.size();
+      if (face_end > face) {
+        face_span span;
+        span.vertices = &chunk.face_vertices[face_vertex];
+        span.num_vertices = &chunk.face_num_vertices[face];
+        span.num_faces = face_end - face;
+        faceGroup.push_back(span);
+        if (chunk_cb) {
+          pieceGroup.push_back(span);
+        }
+        for (; face < face_end; face++) {
+          face_vertex += static_cast<size_t>(chunk.face_num_vertices[face]);
+        }
+      }
+      if (st == chunk.statements.size()) {
+        break;
+      }
+
+      const char *token = chunk.statements[st].line.c_str();
+
+      // use mtl
+      if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
+        char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+        token += 7;
+#ifdef _MSC_VER
+        sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+        std::sscanf(token, "%s", namebuf);
+#endif
+
+        int newMaterialId = -1;
+        if (material_map.find(namebuf) != material_map.end()) {
+          newMaterialId = material_map[namebuf];
+        } else {
+          // { error!! material not found }
+        }
+
+        if (newMaterialId != material) {
+          // Create per-face material. Thus we don't add `shape` to `shapes`
+          // at this time.
+          // just clear `faceGroup` after `exportFaceSpansToShape()` call.
+          exportPiece(&pieces, &pieceShapes, numShapes, &pieceGroup, tags, material, name, triangulate,
+                      vertex_indices_only);
+          addGroupToShape();
+          faceGroup.clear();
+          shapeHasGroupFaces = false;
+          material = newMaterialId;
+        }
+
+        continue;
+      }
+
+      // load mtl
+      if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
+        token += 7;
+
+        std::vector<std::string> filenames;
+        SplitString(std::string(token), ' ', filenames);
+
+        if (filenames.empty()) {
+          if (err) {
+            (*err) +=
+                "WARN: Looks like empty filename for mtllib. Use default "
+                "material. \n";
+          }
+        } else {
+          bool found = false;
+          for (size_t s = 0; s < filenames.size(); s++) {
+            std::string err_mtl;
+            bool ok = (*readMatFn)(filenames[s].c_str(), materials,
+                                   &material_map, &err_mtl);
+            if (err && (!err_mtl.empty())) {
+              (*err) += err_mtl;  // This should be warn message.
+            }
+
+            if (ok) {
+              found = true;
+              break;
+            }
+          }
+
+          if (!found) {
+            if (err) {
+              (*err) +=
+                  "WARN: Failed to load material file(s). Use default "
+                  "material.\n";
+            }
+          }
+        }
+
+        continue;
+      }
+
+      // group name
+      if (token[0] == 'g' && IS_SPACE((token[1]))) {
+        // flush previous face group.
+        exportPiece(&pieces, &pieceShapes, numShapes, &pieceGroup, tags, material, name, triangulate,
+                    vertex_indices_only);
+        bool ret = addGroupToShape();
+        if (ret || shapeHasGroupFaces) {
+          pushShape();
+        }
+        shapeHasGroupFaces = false;
+        shapeHasFaces = false;
+
+        shape = shape_t();
+
+        // material = -1;
+        faceGroup.clear();
+
+        std::vector<std::string> names;
+        names.reserve(2);
+
+        while (!IS_NEW_LINE(token[0])) {
+          std::string str = parseString(&token);
+          names.push_back(str);
+          token += strspn(token, " \t\r");  // skip tag
+        }
+
+        assert(names.size() > 0);
+
+        // names[0] must be 'g', so skip the 0th element.
+        if (names.size() > 1) {
+          name = names[1];
+        } else {
+          name = "";
+        }
+
+        continue;
+      }
+
+      // object name
+      if (token[0] == 'o' && IS_SPACE((token[1]))) {
+        // flush previous face group.
+        exportPiece(&pieces, &pieceShapes, numShapes, &pieceGroup, tags, material, name, triangulate,
+                    vertex_indices_only);
+        bool ret = addGroupToShape();
+        if (ret || shapeHasGroupFaces) {
+          pushShape();
+        }
+        shapeHasGroupFaces = false;
+        shapeHasFaces = false;
+
+        // material = -1;
+        faceGroup.clear();
+        shape = shape_t();
+
+        // @todo { multiple object name? }
+        char namebuf[TINYOBJ_SSCANF_BUFFER_SIZE];
+        token += 2;
+#ifdef _MSC_VER
+        sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+        std::sscanf(token, "%s", namebuf);
+#endif
+        name = std::string(namebuf);
+
+        continue;
+      }
+
+      if (token[0] == 't' && IS_SPACE(token[1])) {
+        tag_t tag;
+
+        char namebuf[4096];
+        token += 2;
+#ifdef _MSC_VER
+        sscanf_s(token, "%s", namebuf, (unsigned)_countof(namebuf));
+#else
+        std::sscanf(token, "%s", namebuf);
+#endif
+        tag.name = std::string(namebuf);
+
+        token += tag.name.size() + 1;
+
+        tag_sizes ts = parseTagTriple(&token);
+
+        tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+
+        for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
+          tag.intValues[i] = atoi(token);
+          token += strcspn(token, "/ \t\r") + 1;
+        }
+
+        tag.floatValues.resize(static_cast<size_t>(ts.num_floats));
+        for (size_t i = 0; i < static_cast<size_t>(ts.num_floats); ++i) {
+          tag.floatValues[i] = parseFloat(&token);
+          token += strcspn(token, "/ \t\r") + 1;
+        }
+
+        tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
+        for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
+          char stringValueBuffer[4096];
+
+#ifdef _MSC_VER
+          sscanf_s(token, "%s", stringValueBuffer,
+                   (unsigned)_countof(stringValueBuffer));
+#else
+          std::sscanf(token, "%s", stringValueBuffer);
+#endif
+          tag.stringValues[i] = stringValueBuffer;
+          token += tag.stringValues[i].size() + 1;
+        }
+
+        tags.push_back(tag);
+      }
+    }
+
+    exportPiece(&pieces, &pieceShapes, numShapes, &pieceGroup, tags, material, name, triangulate,
+                vertex_indices_only);
+    // Add the chunk's faces to the shape and free the chunk, the shape is
+    // pushed once the group ends like it would have been with the faces
+    if (addGroupToShape()) {
+      shapeHasGroupFaces = true;
+    }
+    faceGroup.clear();
+    chunk = obj_chunk();
+
+    if (chunk_cb && !pieces.empty()) {
+      if (!chunk_cb(user_data, *attrib, pieces, pieceShapes)) {
+        cancelled = true;
+        break;
+      }
+      pieces.clear();
+      pieceShapes.clear();
+    }
+  }
+  joiner.join();
+  if (worker_error) {
+    std::rethrow_exception(worker_error);
+  }
+  if (cancelled) {
+    if (err) {
+      (*err) += "Loading [" + std::string(filename) + "] was cancelled\n";
+    }
+    return false;
+  }
+
+  bool ret = addGroupToShape();
+  // exportFaceSpansToShape return false when `usemtl` is called in the last
+  // line.
+  // we also add `shape` to `shapes` when `shape.mesh` has already some
+  // faces(indices)
+  if (ret || (shapes ? shape.mesh.indices.size() ||
+                           shape.mesh.vertex_indices.size()
+                     : shapeHasFaces)) {
+    pushShape();
+  }
+  faceGroup.clear();  // for safety
+
+  if (err) {
+    (*err) += errss.str();
+  }
+
+  return true;
+}
 }  // namespace tinyobj
 
 #endif
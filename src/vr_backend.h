@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ospcommon/vec.h>
+#include <ospcommon/AffineSpace.h>
+#include "frame_timing.h"
+
+// The per eye view parameters of the HMD
+struct EyeParams {
+	/* The raw projection, the tangents of the half angles from the view direction
+	 * to the left, right, top and bottom edges of the image plane. As in OpenVR
+	 * +y points down, so top < bottom
+	 */
+	float left, right, top, bottom;
+	// Position of the eye relative to the head
+	ospcommon::vec3f offset;
+};
+
+/* A VrBackend provides the head poses to render with and presents the rendered
+ * frames. The OpenVR backend talks to a real HMD, while the replay backend reads
+ * recorded poses so the render loop can run headless without a GPU.
+ */
+class VrBackend {
+public:
+	virtual ~VrBackend() {}
+	// Size of each eye's image
+	virtual std::array<uint32_t, 2> render_dims() const = 0;
+	virtual EyeParams eye_params(size_t eye) const = 0;
+	/* Switch to presenting frames with the lens distortion already applied, and get a
+	 * lookup grid of grid_dims points of the distortion for each eye to render them with.
+	 * The grid is in the layout the VR camera's "distortionGrid" takes. Returns false if
+	 * the backend doesn't know the distortion, in which case nothing changes
+	 */
+	virtual bool apply_lens_distortion(const std::array<uint32_t, 2> &grid_dims,
+			std::vector<ospcommon::vec2f> &grid) = 0;
+	/* Get the triangles covering the parts of an eye's image which are hidden by the
+	 * lens, in [0, 1] image coordinates with the first row at the bottom. Returns false
+	 * if the backend doesn't know the hidden area
+	 */
+	virtual bool hidden_area_mesh(size_t eye, std::vector<ospcommon::vec2f> &triangles) const = 0;
+	// Process window and system events, returns false if the app should quit
+	virtual bool poll_events() = 0;
+	/* Wait until it's time to render the next frame and get the HMD pose
+	 * to render it with, returns false if there are no more poses
+	 */
+	virtual bool wait_get_pose(ospcommon::AffineSpace3f &hmd_pose) = 0;
+	/* Get the time of the vsync the frame rendered with the last pose is predicted
+	 * to be shown at, returns false if the backend doesn't present at a vsync
+	 */
+	virtual bool predicted_vsync(std::chrono::steady_clock::time_point &vsync) const = 0;
+	/* Whether the backend can use the depth of the frames, if so they should
+	 * be rendered with a depth channel and passed along with the images
+	 */
+	virtual bool wants_depth() const = 0;
+	/* Present the frame, the image has both eyes side by side with the left eye
+	 * in the left half, stored as sRGB RGBA8 pixels with the first row at the bottom.
+	 * Each eye's half of the image is eye_dims in size, which may be smaller than
+	 * render_dims if the resolution was scaled down to keep the frame rate.
+	 * depth is null or has the distance along each pixel's ray in the same layout,
+	 * and hmd_pose is the pose the frame was rendered with.
+	 * The time spent uploading, blitting and submitting the frame is recorded in times
+	 */
+	virtual void submit(const uint32_t *image, const float *depth, const std::array<uint32_t, 2> &eye_dims,
+			const ospcommon::AffineSpace3f &hmd_pose, FrameTimes &times) = 0;
+	// Show some status text to the user, e.g. the frame time
+	virtual void show_status(const std::string &status) = 0;
+};
+